@@ -1,4 +1,11 @@
 #include "BWEB.h"
+#include "Snapshot.h"
+#include "Trace.h"
+#include <array>
+#include <queue>
+#include <future>
+#include <mutex>
+#include <thread>
 
 // TODO:
 // Restructure - NEW CRITICAL
@@ -12,27 +19,68 @@
 
 namespace BWEB
 {
-	Map::Map(BWEM::Map& map)
-		: mapBWEM(map)
+	namespace
+	{
+		// Anchor tiles a queued Block job tests per step
+		const size_t blockStepTiles = 256;
+	}
+
+	Map::Map(BWEM::Map& map, BWAPI::Game * game)
+		: mapBWEM(map), game(game)
 	{
 	}
 
 	void Map::onStart()
 	{
+		analyze(captureNeutrals());
+	}
+
+	void Map::analyze(const vector<NeutralUnit>& neutrals)
+	{
+		BWEB_TRACE_ZONE("onStart", frame());
+		ScopedTimer timer(stats, Timer::OnStart);
+		sizeGrids();
 		findMain();
 		findNatural();
 		findMainChoke();
 		findNaturalChoke();
 		findStations();
 
-		for (auto &unit : Broodwar->neutral()->getUnits())
-			addOverlap(unit->getTilePosition(), unit->getType().tileWidth(), unit->getType().tileHeight());
+		for (auto& neutral : neutrals)
+			addNeutral(neutral);
+		buildConnectivity();
+		publish();
+	}
+
+	vector<Map::NeutralUnit> Map::captureNeutrals() const
+	{
+		// Every neutral onStart rasterizes, BWEM knows about the ones we can't see yet
+		vector<NeutralUnit> neutrals;
+		for (auto& m : mapBWEM.Minerals())
+			neutrals.push_back(neutralOf(m->Unit(), NeutralType::Mineral));
+		for (auto& g : mapBWEM.Geysers())
+			neutrals.push_back(neutralOf(g->Unit(), NeutralType::Geyser));
+		for (auto& n : mapBWEM.StaticBuildings())
+			neutrals.push_back(neutralOf(n->Unit(), NeutralType::StaticBuilding));
+		for (auto &unit : game->neutral()->getUnits())
+			neutrals.push_back(neutralOf(unit, NeutralType::Other));
+		neutrals.erase(remove_if(neutrals.begin(), neutrals.end(), [](const NeutralUnit& neutral) { return neutral.id < 0; }), neutrals.end());
+		return neutrals;
 	}
 
 	void Map::onUnitDiscover(const Unit unit)
 	{
-		if (!unit || !unit->exists() || !unit->getType().isBuilding() || unit->isFlying()) return;
-		if (unit->getType() == UnitTypes::Resource_Vespene_Geyser) return;
+		if (deferWhileBusy([this, unit]() { onUnitDiscover(unit); }))
+			return;
+		flushPending();
+
+		if (unit && unit->getPlayer() == game->neutral())
+			addNeutral(neutralOf(unit, NeutralType::Other));
+
+		if (!unit || !unit->exists() || !unit->getType().isBuilding() || unit->isFlying() || unit->getType() == UnitTypes::Resource_Vespene_Geyser) {
+			publishLater();
+			return;
+		}
 
 		const auto tile(unit->getTilePosition());
 		auto type(unit->getType());
@@ -46,6 +94,25 @@ namespace BWEB
 				usedTiles.insert(t);
 			}
 		}
+		usedTilesChanged = true;
+		updateSlots(tile, type.tileWidth(), type.tileHeight());
+		occupancyChanged(tile, type.tileWidth(), type.tileHeight());
+
+		// A reservation is done once a building stands on it
+		for (auto it = reservations.begin(); it != reservations.end();) {
+			const auto& r = *it;
+			if (r.tile.x < tile.x + type.tileWidth() && tile.x < r.tile.x + r.type.tileWidth() && r.tile.y < tile.y + type.tileHeight() && tile.y < r.tile.y + r.type.tileHeight()) {
+				clearReservation(r);
+				it = reservations.erase(it);
+			}
+			else
+				++it;
+		}
+
+		// Taking a base builds the Blocks of its area
+		if (lazyBlocks && type.isResourceDepot() && unit->getPlayer() == game->self())
+			findBlocks(mapBWEM.GetNearestArea(tile));
+		publishLater();
 	}
 
 	void Map::onUnitMorph(const Unit unit)
@@ -55,7 +122,17 @@ namespace BWEB
 
 	void Map::onUnitDestroy(const Unit unit)
 	{
-		if (!unit || !unit->getType().isBuilding() || unit->isFlying()) return;
+		if (deferWhileBusy([this, unit]() { onUnitDestroy(unit); }))
+			return;
+		flushPending();
+
+		if (unit && unit->getPlayer() == game->neutral())
+			removeNeutral(unit);
+
+		if (!unit || !unit->getType().isBuilding() || unit->isFlying()) {
+			publishLater();
+			return;
+		}
 
 		const auto tile(unit->getTilePosition());
 		auto type(unit->getType());
@@ -69,17 +146,224 @@ namespace BWEB
 				usedTiles.erase(t);
 			}
 		}
+		usedTilesChanged = true;
+		updateSlots(tile, type.tileWidth(), type.tileHeight());
+		occupancyChanged(tile, type.tileWidth(), type.tileHeight());
+
+		// Our own buildings outside of Blocks leave space that Blocks can fill, enemy buildings dying doesn't free anything we would build on
+		if (blockRace != Races::None && unit->getPlayer() == game->self() && overlapGrid.contains(tile.x, tile.y) && overlapGrid[tile.x][tile.y] == 0)
+			dirtyRegions.emplace_back(tile, tile + TilePosition(type.tileWidth() - 1, type.tileHeight() - 1));
+		publishLater();
+	}
+
+	void Map::setPerspective(const TilePosition start, const BWAPI::Race race)
+	{
+		perspectiveStart = start;
+		perspectiveRace = race;
+	}
+
+	void Map::onStartAsync(const function<void(Map&)>& walls)
+	{
+		if (analysis.valid())
+			analysis.wait();
+
+		// Everything the analysis needs from the live game is read here, the thread only reads this copy and the terrain
+		setPerspective(startLocation(), selfRace());
+		analysisFrame = game->getFrameCount();
+		const auto neutrals = captureNeutrals();
+
+		// Every subsystem is busy until the analysis reaches it
+		const auto promises = make_shared<array<promise<void>, int(Subsystem::Count)>>();
+		for (int i = 0; i < int(Subsystem::Count); i++) {
+			ready[i].store(false, memory_order_release);
+			readyFutures[i] = (*promises)[i].get_future().share();
+		}
+
+		analysis = async(launch::async, [this, walls, promises, neutrals]() {
+			analysisThread.store(this_thread::get_id());
+			const auto finish = [&](const Subsystem subsystem) {
+				ready[int(subsystem)].store(true, memory_order_release);
+				(*promises)[int(subsystem)].set_value();
+			};
+
+			analyze(neutrals);
+			finish(Subsystem::Stations);
+			if (walls)
+				walls(*this);
+			finish(Subsystem::Walls);
+			findBlocks();
+			finish(Subsystem::Blocks);
+			analysisThread.store(thread::id());
+		});
+	}
+
+	bool Map::isReady(const Subsystem subsystem) const
+	{
+		return ready[int(subsystem)].load(memory_order_acquire);
+	}
+
+	shared_future<void> Map::whenReady(const Subsystem subsystem) const
+	{
+		if (readyFutures[int(subsystem)].valid())
+			return readyFutures[int(subsystem)];
+
+		// Nothing was ever started in the background, so it's ready now
+		promise<void> done;
+		done.set_value();
+		return done.get_future().share();
+	}
+
+	bool Map::busy(const Subsystem subsystem) const
+	{
+		return !ready[int(subsystem)].load(memory_order_acquire) && !onAnalysisThread();
+	}
+
+	bool Map::deferWhileBusy(function<void()> call)
+	{
+		// The game thread can't change the layout while the analysis thread is still building it
+		if (!busy(Subsystem::Blocks))
+			return false;
+		pendingCalls.push_back(move(call));
+		return true;
+	}
+
+	void Map::flushPending()
+	{
+		// The walls callback can reach here on the analysis thread through a placement query, only the game thread replays once Blocks are ready
+		if (pendingCalls.empty() || !isReady(Subsystem::Blocks))
+			return;
+
+		// Replayed in the order they happened
+		auto calls = move(pendingCalls);
+		pendingCalls.clear();
+		for (auto& call : calls)
+			call();
+	}
+
+	void Map::setKeepConnected(const bool keep)
+	{
+		if (deferWhileBusy([this, keep]() { setKeepConnected(keep); }))
+			return;
+		keepConnected = keep;
+	}
+
+	bool Map::update(const double budgetMs)
+	{
+		BWEB_TRACE_ZONE("update", frame());
+		// Nothing is stepped while onStartAsync still owns the layout
+		if (busy(Subsystem::Stations) || busy(Subsystem::Walls) || busy(Subsystem::Blocks))
+			return true;
+
+		ScopedTimer timer(stats, Timer::Update);
+		flushPending();
+		queueDirtyRegions();
+		const auto pending = scheduler.run(budgetMs);
+		publish();
+		return pending;
+	}
+
+	void Map::queueJob(const Priority priority, function<bool()> step)
+	{
+		scheduler.push(priority, move(step));
+	}
+
+	void Map::queueBlocks(const BWEM::Area * area, const Priority priority)
+	{
+		if (!area || blockRace == Races::None || !areasWithBlocks.insert(area).second)
+			return;
+		queueBlockPasses({ make_tuple(area->TopLeft(), area->BottomRight(), area) }, priority);
+	}
+
+	void Map::queueDirtyRegions()
+	{
+		// Freed regions are refilled over the next frames instead of all at once on the next getBuildPosition
+		vector<tuple<TilePosition, TilePosition, const BWEM::Area *>> regions;
+		for (auto& region : dirtyRegions) {
+			if (lazyBlocks && areasWithBlocks.find(mapBWEM.GetNearestArea(region.first)) == areasWithBlocks.end())
+				continue;
+			regions.emplace_back(region.first, region.second, nullptr);
+		}
+		dirtyRegions.clear();
+		if (!regions.empty())
+			queueBlockPasses(move(regions), Priority::Low);
+	}
+
+	void Map::queueBlockPasses(vector<tuple<TilePosition, TilePosition, const BWEM::Area *>> regions, const Priority priority)
+	{
+		// Gathering the anchor tiles of a region is one step, then every step tests a few of them
+		scheduler.push(priority, [this, regions = move(regions), next = size_t(0), pass = BlockPass(), started = false]() mutable {
+			if (started) {
+				if (!stepBlocks(pass, blockStepTiles))
+					return false;
+				started = false;
+			}
+			if (next == regions.size()) {
+				publish();
+				return true;
+			}
+			auto& region = regions[next++];
+			pass = beginBlocks(blockRace, get<0>(region), get<1>(region), get<2>(region));
+			started = true;
+			return false;
+		});
+	}
+
+	void Map::findLayouts(const BWAPI::Race race, const function<void(Map&)>& walls)
+	{
+		layouts.clear();
+		const auto neutrals = captureNeutrals();
+		for (auto& start : game->getStartLocations()) {
+			if (start == startLocation())
+				continue;
+			layouts[start] = make_unique<Map>(mapBWEM, game);
+			layouts[start]->setPerspective(start, race);
+		}
+
+		// Every layout only reads the game and BWEM, and nothing changes them until every thread is joined, so they can all run at once. The callback is the user's and runs one layout at a time
+		vector<thread> threads;
+		mutex wallsMutex;
+		for (auto& layout : layouts) {
+			const auto map = layout.second.get();
+			threads.emplace_back([map, race, &neutrals, &walls, &wallsMutex]() {
+				map->analyze(neutrals);
+				if (walls) {
+					lock_guard<mutex> lock(wallsMutex);
+					walls(*map);
+				}
+				map->findBlocks(race);
+			});
+		}
+		for (auto& t : threads)
+			t.join();
+	}
+
+	const Map* Map::getLayout(const TilePosition start) const
+	{
+		const auto it = layouts.find(start);
+		return it != layouts.end() ? it->second.get() : nullptr;
+	}
+
+	TilePosition Map::startLocation() const
+	{
+		return perspectiveStart.isValid() ? perspectiveStart : game->self()->getStartLocation();
+	}
+
+	BWAPI::Race Map::selfRace() const
+	{
+		return perspectiveRace != Races::None ? perspectiveRace : game->self()->getRace();
 	}
 
 	void Map::findMain()
 	{
-		mainTile = Broodwar->self()->getStartLocation();
+		BWEB_TRACE_ZONE("findMain", frame());
+		mainTile = startLocation();
 		mainPosition = static_cast<Position>(mainTile) + Position(64, 48);
 		mainArea = mapBWEM.GetArea(mainTile);
 	}
 
 	void Map::findNatural()
 	{
+		BWEB_TRACE_ZONE("findNatural", frame());
 		auto distBest = DBL_MAX;
 		for (auto& area : mapBWEM.Areas())
 		{
@@ -100,6 +384,7 @@ namespace BWEB
 
 	void Map::findMainChoke()
 	{
+		BWEB_TRACE_ZONE("findMainChoke", frame());
 		auto distBest = DBL_MAX;
 		for (auto& choke : naturalArea->ChokePoints())
 		{
@@ -111,6 +396,7 @@ namespace BWEB
 
 	void Map::findNaturalChoke()
 	{
+		BWEB_TRACE_ZONE("findNaturalChoke", frame());
 		// Exception for maps with a natural behind the main such as Crossing Fields
 		if (getGroundDistance(mainPosition, mapBWEM.Center()) < getGroundDistance(Position(naturalTile), mapBWEM.Center()))
 		{
@@ -136,63 +422,97 @@ namespace BWEB
 			if (choke->Center() == mainChoke->Center()) continue;
 			if (choke->Blocked() || choke->Geometry().size() <= 3) continue;
 			if (choke->GetAreas().first != second && choke->GetAreas().second != second) continue;
-			const auto dist = Position(choke->Center()).getDistance(Position(Broodwar->self()->getStartLocation()));
+			const auto dist = Position(choke->Center()).getDistance(Position(startLocation()));
 			if (dist < distBest)
 				naturalChoke = choke, distBest = dist;
 		}
 	}
 
-	void Map::draw()
+	void Map::buildDrawLists()
 	{
+		for (auto& column : drawCells) {
+			for (auto& cell : column)
+				cell.clear();
+		}
+
+		// Every shape goes in the cell of its top left corner
+		const auto add = [&](const DrawShape::Kind kind, const Position topLeft, const Position bottomRight) {
+			const auto x = clamp(topLeft.x / drawCellSize, 0, 31);
+			const auto y = clamp(topLeft.y / drawCellSize, 0, 31);
+			drawCells[x][y].push_back({ kind, topLeft, bottomRight });
+		};
+
 		for (auto& block : blocks) {
-			for (auto& tile : block.SmallTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(65, 65), Broodwar->self()->getColor());
-			for (auto& tile : block.MediumTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(97, 65), Broodwar->self()->getColor());
-			for (auto& tile : block.LargeTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(129, 97), Broodwar->self()->getColor());
+			const auto& slots = block.Slots();
+			for (size_t i = 0; i < slots.size(); i++)
+				add(DrawShape::Box, Position(slots.tile(i)), Position(slots.tile(i) + footprintSize(slots.footprint(i))) + Position(1, 1));
 		}
 
 		for (auto& station : stations) {
 			for (auto& tile : station.DefenseLocations())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(65, 65), Broodwar->self()->getColor());
-			Broodwar->drawBoxMap(Position(station.BWEMBase()->Location()), Position(station.BWEMBase()->Location()) + Position(129, 97), Broodwar->self()->getColor());
+				add(DrawShape::Box, Position(tile), Position(tile) + Position(65, 65));
+			add(DrawShape::Box, Position(station.BWEMBase()->Location()), Position(station.BWEMBase()->Location()) + Position(129, 97));
 		}
 
 		for (auto& wall : walls) {
-			for (auto& tile : wall.smallTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(65, 65), Broodwar->self()->getColor());
-			for (auto& tile : wall.mediumTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(97, 65), Broodwar->self()->getColor());
-			for (auto& tile : wall.largeTiles())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(129, 97), Broodwar->self()->getColor());
-			for (auto& tile : wall.getDefenses())
-				Broodwar->drawBoxMap(Position(tile), Position(tile) + Position(65, 65), Broodwar->self()->getColor());
-			Broodwar->drawBoxMap(Position(wall.getDoor()), Position(wall.getDoor()) + Position(33, 33), Broodwar->self()->getColor(), true);
-			Broodwar->drawCircleMap(Position(wall.getCentroid()) + Position(16, 16), 8, Broodwar->self()->getColor(), true);
-		}
-
-		for (int x = 0; x < Broodwar->mapWidth(); x++)
-		{
-			for (int y = 0; y < Broodwar->mapHeight(); y++)
-			{
-				TilePosition t(x, y);
-				//if (visited[UnitTypes::Protoss_Gateway].location[t.x][t.y] == 1)
-				//	Broodwar->drawBoxMap(Position(t), Position(t) + Position(33, 33), Colors::Yellow, false);
+			const auto& slots = wall.getSlots();
+			for (size_t i = 0; i < slots.size(); i++)
+				add(DrawShape::Box, Position(slots.tile(i)), Position(slots.tile(i) + footprintSize(slots.footprint(i))) + Position(1, 1));
+			if (wall.getDoor().isValid())
+				add(DrawShape::SolidBox, Position(wall.getDoor()), Position(wall.getDoor()) + Position(33, 33));
+			add(DrawShape::Circle, Position(wall.getCentroid()) + Position(8, 8), Position(wall.getCentroid()) + Position(24, 24));
+		}
+
+		for (int x = 0; x < reserveGrid.width(); x++) {
+			for (int y = 0; y < reserveGrid.height(); y++) {
 				if (reserveGrid[x][y] >= 1)
-					Broodwar->drawBoxMap(Position(t), Position(t) + Position(33, 33), Colors::Black, false);
+					add(DrawShape::Reserved, Position(TilePosition(x, y)), Position(TilePosition(x, y)) + Position(33, 33));
+			}
+		}
+	}
+
+	void Map::draw()
+	{
+		if (busy(Subsystem::Blocks) || !gridsSized())
+			return;
+
+		// The layout only changes when a new snapshot is published
+		const auto current = getSnapshot();
+		const auto version = current ? current->getVersion() : 0;
+		if (version != drawVersion) {
+			buildDrawLists();
+			drawVersion = version;
+		}
+
+		// Only visit cells that can hold a shape on screen, a shape reaches at most one cell past the cell it's stored in
+		const auto screen = game->getScreenPosition();
+		const auto screenEnd = screen + Position(640, 480);
+		const auto color = game->self()->getColor();
+		for (auto x = max(0, screen.x / drawCellSize - 1); x <= min(31, screenEnd.x / drawCellSize); x++) {
+			for (auto y = max(0, screen.y / drawCellSize - 1); y <= min(31, screenEnd.y / drawCellSize); y++) {
+				for (auto& shape : drawCells[x][y]) {
+					if (shape.bottomRight.x < screen.x || shape.bottomRight.y < screen.y || shape.topLeft.x > screenEnd.x || shape.topLeft.y > screenEnd.y)
+						continue;
+
+					switch (shape.kind) {
+					case DrawShape::Box: game->drawBoxMap(shape.topLeft, shape.bottomRight, color); break;
+					case DrawShape::SolidBox: game->drawBoxMap(shape.topLeft, shape.bottomRight, color, true); break;
+					case DrawShape::Circle: game->drawCircleMap((shape.topLeft + shape.bottomRight) / 2, 8, color, true); break;
+					case DrawShape::Reserved: game->drawBoxMap(shape.topLeft, shape.bottomRight, Colors::Black, false); break;
+					}
+				}
 			}
 		}
 
-		//Broodwar->drawCircleMap(Position(startTile), 8, Colors::Green, true);
-		//Broodwar->drawCircleMap(Position(endTile), 8, Colors::Orange, true);
-		//Broodwar->drawCircleMap(naturalPosition, 8, Colors::Red, true);
-		//Broodwar->drawCircleMap(Position(mainChoke->Center()), 8, Colors::Green, true);
-		//Broodwar->drawCircleMap(Position(naturalChoke->Center()), 8, Colors::Yellow, true);
+		//game->drawCircleMap(Position(startTile), 8, Colors::Green, true);
+		//game->drawCircleMap(Position(endTile), 8, Colors::Orange, true);
+		//game->drawCircleMap(naturalPosition, 8, Colors::Red, true);
+		//game->drawCircleMap(Position(mainChoke->Center()), 8, Colors::Green, true);
+		//game->drawCircleMap(Position(naturalChoke->Center()), 8, Colors::Yellow, true);
 	}
 
 	template <class PositionType>
-	double Map::getGroundDistance(PositionType start, PositionType end)
+	double Map::getGroundDistance(PositionType start, PositionType end) const
 	{
 		auto dist = 0.0;
 		if (!start.isValid() || !end.isValid() || !mapBWEM.GetArea(WalkPosition(start)) || !mapBWEM.GetArea(WalkPosition(end)))
@@ -208,57 +528,136 @@ namespace BWEB
 		return dist += start.getDistance(end);
 	}
 
-	TilePosition Map::getBuildPosition(UnitType type, const TilePosition searchCenter)
+	TilePosition Map::getBuildPosition(UnitType type, TilePosition searchCenter, const Distance distance)
 	{
-		auto distBest = DBL_MAX;
-		auto tileBest = TilePositions::Invalid;
+		ScopedTimer timer(stats, Timer::GetBuildPosition);
+		if (busy(Subsystem::Blocks))
+			return TilePositions::Invalid;
+		flushPending();
+		expireReservations();
+		if (searchCenter == TilePositions::None)
+			searchCenter = startLocation();
+		if (lazyBlocks)
+			findBlocks(mapBWEM.GetNearestArea(searchCenter));
+		regenerateBlocks();
+		publish();
+		return closestFreeSlot(blockSlots(footprintOf(type)), type, searchCenter, distance);
+	}
 
-		// Search through each block to find the closest block and valid position
-		for (auto& block : blocks) {
-			set<TilePosition> placements;
-			if (type.tileWidth() == 4) placements = block.LargeTiles();
-			else if (type.tileWidth() == 3) placements = block.MediumTiles();
-			else placements = block.SmallTiles();
-
-			for (auto& tile : placements) {
-				const auto dist = tile.getDistance(searchCenter);
-				if (dist < distBest && isPlaceable(type, tile))
-					distBest = dist, tileBest = tile;
+	TilePosition Map::getBuildPosition(UnitType type, TilePosition searchCenter, const Distance distance) const
+	{
+		ScopedTimer timer(stats, Timer::GetBuildPosition);
+		if (busy(Subsystem::Blocks))
+			return TilePositions::Invalid;
+		if (searchCenter == TilePositions::None)
+			searchCenter = startLocation();
+		return closestFreeSlot(blockSlots(footprintOf(type)), type, searchCenter, distance);
+	}
+
+	TilePosition Map::getDefBuildPosition(UnitType type, TilePosition searchCenter, const Distance distance)
+	{
+		ScopedTimer timer(stats, Timer::GetDefBuildPosition);
+		if (busy(Subsystem::Walls))
+			return TilePositions::Invalid;
+		flushPending();
+		expireReservations();
+		if (searchCenter == TilePositions::None)
+			searchCenter = startLocation();
+		// Wall and station defenses share one index
+		return closestFreeSlot(defenseSlots, type, searchCenter, distance);
+	}
+
+	TilePosition Map::getDefBuildPosition(UnitType type, TilePosition searchCenter, const Distance distance) const
+	{
+		ScopedTimer timer(stats, Timer::GetDefBuildPosition);
+		if (busy(Subsystem::Walls))
+			return TilePositions::Invalid;
+		if (searchCenter == TilePositions::None)
+			searchCenter = startLocation();
+		return closestFreeSlot(defenseSlots, type, searchCenter, distance);
+	}
+
+	vector<TilePosition> Map::getBuildPositions(const vector<BuildRequest>& requests, const int frames, const Distance distance)
+	{
+		vector<TilePosition> positions(requests.size(), TilePositions::Invalid);
+		if (busy(Subsystem::Blocks))
+			return positions;
+		flushPending();
+		expireReservations();
+
+		// Blocks are made ready for every search center before any slot is picked
+		for (auto& request : requests) {
+			if (lazyBlocks && !request.defense)
+				findBlocks(mapBWEM.GetNearestArea(request.searchCenter == TilePositions::None ? startLocation() : request.searchCenter));
+		}
+		regenerateBlocks();
+
+		// Each reservation takes its slot out of the free index, so the next request never sees it
+		for (size_t i = 0; i < requests.size(); i++) {
+			auto& request = requests[i];
+			const auto searchCenter = request.searchCenter == TilePositions::None ? startLocation() : request.searchCenter;
+			const auto& index = request.defense ? defenseSlots : blockSlots(footprintOf(request.type));
+			positions[i] = closestFreeSlot(index, request.type, searchCenter, distance);
+			if (positions[i].isValid())
+				reserve(positions[i], request.type, frames);
+		}
+		publish();
+		return positions;
+	}
+
+	void Map::reserve(const TilePosition here, const UnitType type, const int frames)
+	{
+		// A reservation lasts at least until the next frame, otherwise it would be expired before anyone saw it
+		const auto expires = game->getFrameCount() + max(frames, 1);
+		for (auto x = here.x; x < here.x + type.tileWidth(); x++) {
+			for (auto y = here.y; y < here.y + type.tileHeight(); y++) {
+				if (reservationGrid.contains(x, y))
+					reservationGrid[x][y] = expires;
 			}
 		}
-		return tileBest;
+		reservations.push_back({ here, type, expires });
+		updateSlots(here, type.tileWidth(), type.tileHeight());
 	}
 
-	TilePosition Map::getDefBuildPosition(UnitType type, const TilePosition searchCenter)
+	void Map::clearReservation(const Reservation& reservation)
 	{
-		auto distBest = DBL_MAX;
-		auto tileBest = TilePositions::Invalid;
+		// A tile is only cleared if no newer reservation took it over
+		const auto here = reservation.tile;
+		for (auto x = here.x; x < here.x + reservation.type.tileWidth(); x++) {
+			for (auto y = here.y; y < here.y + reservation.type.tileHeight(); y++) {
+				if (reservationGrid.contains(x, y) && reservationGrid[x][y] == reservation.expires)
+					reservationGrid[x][y] = 0;
+			}
+		}
+		updateSlots(here, reservation.type.tileWidth(), reservation.type.tileHeight());
+	}
 
-		// Search through each wall to find the closest valid TilePosition
-		for (auto& wall : walls)
-		{
-			for (auto& tile : wall.getDefenses())
-			{
-				const auto dist = tile.getDistance(searchCenter);
-				if (dist < distBest && isPlaceable(type, tile))
-					distBest = dist, tileBest = tile;
+	void Map::expireReservations()
+	{
+		const auto frame = game->getFrameCount();
+		for (auto it = reservations.begin(); it != reservations.end();) {
+			if (it->expires > frame) {
+				++it;
+				continue;
 			}
+			clearReservation(*it);
+			it = reservations.erase(it);
 		}
+	}
 
-		// Search through each station to find the closest valid TilePosition
-		for (auto& station : stations)
-		{
-			for (auto& tile : station.DefenseLocations())
-			{
-				const auto dist = tile.getDistance(searchCenter);
-				if (dist < distBest && isPlaceable(type, tile))
-					distBest = dist, tileBest = tile;
+	void Map::releaseReservation(const TilePosition here)
+	{
+		for (auto it = reservations.begin(); it != reservations.end(); ++it) {
+			if (it->tile == here) {
+				clearReservation(*it);
+				reservations.erase(it);
+				publish();
+				return;
 			}
 		}
-		return tileBest;
 	}
 
-	bool Map::isPlaceable(UnitType type, const TilePosition location)
+	bool Map::isPlaceable(UnitType type, const TilePosition location) const
 	{
 		// Placeable is valid if buildable and not overlapping neutrals
 		// Note: Must check neutrals due to the terrain below them technically being buildable
@@ -267,38 +666,526 @@ namespace BWEB
 
 			if (creepCheck) {
 				TilePosition tile(x, location.y + 2);
-				if (!Broodwar->isBuildable(tile))
+				if (!game->isBuildable(tile))
 					return false;
 			}
 
 			for (auto y = location.y; y < location.y + type.tileHeight(); y++)	{
 				TilePosition tile(x, y);
-				if (!tile.isValid() || !Broodwar->isBuildable(tile)) return false;
+				if (!overlapGrid.contains(x, y) || !game->isBuildable(tile)) return false;
 				if (usedTiles.find(tile) != usedTiles.end()) return false;
 				if (reserveGrid[x][y] > 0) return false;
-				if (type.isResourceDepot() && !Broodwar->canBuildHere(tile, type)) return false;
+				if (type.isResourceDepot() && !onAnalysisThread() && !game->canBuildHere(tile, type)) return false;
 			}
 		}
 
+		// canBuildHere reads the live game, the analysis thread checks the resource distance against the neutrals it was given instead
+		if (type.isResourceDepot() && onAnalysisThread() && !clearOfResources(type, location))
+			return false;
+		return true;
+	}
+
+	bool Map::clearOfResources(UnitType type, const TilePosition location) const
+	{
+		// Resource depots can't be built within 3 tiles of a mineral field or geyser
+		for (auto x = location.x - 3; x < location.x + type.tileWidth() + 3; x++) {
+			for (auto y = location.y - 3; y < location.y + type.tileHeight() + 3; y++) {
+				if (!neutralGrid.contains(x, y))
+					continue;
+				const auto neutral = neutralGrid[x][y].type;
+				if (neutral == NeutralType::Mineral || neutral == NeutralType::Geyser)
+					return false;
+			}
+		}
 		return true;
 	}
 
-	void Map::addOverlap(const TilePosition t, const int w, const int h)
+	SlotIndex& Map::blockSlots(const Footprint footprint)
 	{
+		if (footprint == Footprint::Large) return largeSlots;
+		if (footprint == Footprint::Medium) return mediumSlots;
+		return smallSlots;
+	}
+
+	const SlotIndex& Map::blockSlots(const Footprint footprint) const
+	{
+		if (footprint == Footprint::Large) return largeSlots;
+		if (footprint == Footprint::Medium) return mediumSlots;
+		return smallSlots;
+	}
+
+	void Map::insertSlot(SlotIndex& index, const TilePosition here)
+	{
+		slotsChanged = true;
+		index.slots.insert(here);
+		if (isSlotFree(index, here))
+			index.free.insert(here);
+	}
+
+	void Map::eraseSlot(SlotIndex& index, const TilePosition here)
+	{
+		slotsChanged = true;
+		index.slots.erase(here);
+		index.free.erase(here);
+	}
+
+	void Map::insertSlots(const Block& block)
+	{
+		const auto& slots = block.Slots();
+		for (size_t i = 0; i < slots.size(); i++)
+			insertSlot(blockSlots(slots.footprint(i)), slots.tile(i));
+	}
+
+	void Map::eraseSlots(const Block& block)
+	{
+		const auto& slots = block.Slots();
+		for (size_t i = 0; i < slots.size(); i++)
+			eraseSlot(blockSlots(slots.footprint(i)), slots.tile(i));
+	}
+
+	void Map::updateSlots(const TilePosition here, const int width, const int height)
+	{
+		slotsChanged = true;
+
+		// Only slots whose footprint can intersect the changed tiles need to be checked again
+		for (auto index : { &smallSlots, &mediumSlots, &largeSlots, &defenseSlots }) {
+			const auto first = index->slots.lower_bound(TilePosition(here.x - index->width + 1, INT_MIN));
+			const auto last = index->slots.upper_bound(TilePosition(here.x + width - 1, INT_MAX));
+			for (auto it = first; it != last; ++it) {
+				const auto tile = *it;
+				if (tile.y <= here.y - index->height || tile.y >= here.y + height)
+					continue;
+
+				if (isSlotFree(*index, tile))
+					index->free.insert(tile);
+				else
+					index->free.erase(tile);
+			}
+		}
+	}
+
+	bool Map::isSlotFree(const SlotIndex& index, const TilePosition here) const
+	{
+		for (auto x = here.x; x < here.x + index.width; x++) {
+			for (auto y = here.y; y < here.y + index.height; y++) {
+				if (usedTiles.find(TilePosition(x, y)) != usedTiles.end())
+					return false;
+				if (reservationGrid.contains(x, y) && reservationGrid[x][y] > game->getFrameCount())
+					return false;
+			}
+		}
+		return true;
+	}
+
+	TilePosition Map::closestFreeSlot(const SlotIndex& index, UnitType type, const TilePosition searchCenter, const Distance distance) const
+	{
+		if (distance == Distance::Ground)
+			return closestSlotByGround(index, type, searchCenter);
+		return closestSlot(index, searchCenter, [&](const TilePosition tile) { return isPlaceable(type, tile); });
+	}
+
+	TilePosition Map::closestSlotByGround(const SlotIndex& index, UnitType type, const TilePosition searchCenter) const
+	{
+		if (index.free.empty() || !searchCenter.isValid())
+			return TilePositions::Invalid;
+
+		// The closest slot in a straight line bounds the search, a slot much further to walk than that isn't worth finding and the search gives up on it
+		const auto placeable = [&](const TilePosition tile) { return isPlaceable(type, tile); };
+		const auto airBest = closestSlot(index, searchCenter, placeable);
+		if (!airBest.isValid())
+			return TilePositions::Invalid;
+		const auto maxCost = uint32_t(max(2.0 * airBest.getDistance(searchCenter), 32.0) * 10.0);
+
+		if (groundCost.width() != game->mapWidth() || groundCost.height() != game->mapHeight()) {
+			groundCost.resize(game->mapWidth(), game->mapHeight());
+			groundSeen.resize(game->mapWidth(), game->mapHeight());
+			groundStamp = 0;
+		}
+		if (++groundStamp == 0) {
+			groundSeen.resize(game->mapWidth(), game->mapHeight());
+			groundStamp = 1;
+		}
+
+		// One Dijkstra from the search center, the first free slot it pops is the closest one to walk to, falls back to the air slot when nothing is within the bound
+		const TilePosition directions[8] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 } };
+		const auto passable = [&](const TilePosition t) { return t.isValid() && isWalkable(t) && usedTiles.find(t) == usedTiles.end(); };
+		using Entry = pair<uint32_t, TilePosition>;
+		const auto cheaper = [](const Entry& l, const Entry& r) { return l.first > r.first; };
+		priority_queue<Entry, vector<Entry>, decltype(cheaper)> open(cheaper);
+
+		groundCost[searchCenter.x][searchCenter.y] = 0;
+		groundSeen[searchCenter.x][searchCenter.y] = groundStamp;
+		open.emplace(0, searchCenter);
+
+		uint64_t expanded = 0;
+		auto tileBest = airBest;
+		while (!open.empty()) {
+			const auto current = open.top();
+			open.pop();
+			const auto tile = current.second;
+			if (current.first != groundCost[tile.x][tile.y])
+				continue;
+			if (current.first > maxCost)
+				break;
+			expanded++;
+
+			if (index.free.find(tile) != index.free.end() && placeable(tile)) {
+				tileBest = tile;
+				break;
+			}
+
+			for (int i = 0; i < 8; i++) {
+				const auto next = tile + directions[i];
+				if (!passable(next) || (i >= 4 && (!passable(TilePosition(next.x, tile.y)) || !passable(TilePosition(tile.x, next.y)))))
+					continue;
+				const auto cost = current.first + (i < 4 ? 10 : 14);
+				if (cost > maxCost)
+					continue;
+				if (groundSeen[next.x][next.y] == groundStamp && cost >= groundCost[next.x][next.y])
+					continue;
+				groundSeen[next.x][next.y] = groundStamp;
+				groundCost[next.x][next.y] = cost;
+				open.emplace(cost, next);
+			}
+		}
+		stats.count(Counter::PathNodes, expanded);
+		return tileBest;
+	}
+
+	Map::NeutralUnit Map::neutralOf(const Unit unit, NeutralType neutralType)
+	{
+		if (!unit)
+			return { -1, UnitTypes::None, TilePositions::Invalid, NeutralType::None };
+
+		// Units we only know as neutral are classified by their type
+		const auto type = unit->getType();
+		if (neutralType == NeutralType::Other) {
+			if (type.isMineralField()) neutralType = NeutralType::Mineral;
+			else if (type == UnitTypes::Resource_Vespene_Geyser) neutralType = NeutralType::Geyser;
+			else if (type.isBuilding()) neutralType = NeutralType::StaticBuilding;
+		}
+		return { unit->getID(), type, unit->getInitialTilePosition(), neutralType };
+	}
+
+	void Map::addNeutral(const NeutralUnit& neutral)
+	{
+		if (neutral.id < 0)
+			return;
+
+		// Neutrals we already know, from BWEM or an earlier discover, change nothing
+		auto changed = false;
+		const auto tile = neutral.tile;
+		const auto type = neutral.type;
+		for (auto x = tile.x; x < tile.x + type.tileWidth(); x++) {
+			for (auto y = tile.y; y < tile.y + type.tileHeight(); y++) {
+				TilePosition t(x, y);
+				if (!t.isValid() || (neutralGrid[x][y].type == neutral.neutralType && neutralGrid[x][y].id == neutral.id && (layerGrid[x][y] & layerBit(OwnerType::Neutral)))) continue;
+				neutralGrid[x][y].type = neutral.neutralType;
+				neutralGrid[x][y].id = neutral.id;
+				changed = true;
+			}
+		}
+		if (!changed)
+			return;
+		neutralChanged = true;
+		addOverlap(tile, type.tileWidth(), type.tileHeight(), Owner{ OwnerType::Neutral, neutral.id });
+	}
+
+	void Map::removeNeutral(const Unit unit)
+	{
+		if (!unit)
+			return;
+
+		// Only the tiles this neutral still covers are opened up, in every grid addNeutral wrote to
+		auto changed = false;
+		const auto type = unit->getType();
+		const auto tile = unit->getInitialTilePosition();
+		for (auto x = tile.x; x < tile.x + type.tileWidth(); x++) {
+			for (auto y = tile.y; y < tile.y + type.tileHeight(); y++) {
+				TilePosition t(x, y);
+				if (!t.isValid() || neutralGrid[x][y].id != unit->getID()) continue;
+				neutralGrid[x][y] = NeutralTile();
+				removeOverlap(x, y, OwnerType::Neutral);
+				changed = true;
+			}
+		}
+		if (!changed)
+			return;
+		neutralChanged = overlapChanged = true;
+		occupancyChanged(tile, type.tileWidth(), type.tileHeight());
+	}
+
+	void Map::sizeGrids()
+	{
+		const auto width = game->mapWidth(), height = game->mapHeight();
+		overlapGrid.resize(width, height);
+		reserveGrid.resize(width, height);
+		neutralGrid.resize(width, height);
+		ownerGrid.resize(width, height);
+		layerGrid.resize(width, height);
+		reservationGrid.resize(width, height);
+		reservations.clear();
+		visited.clear();
+		connectivity = Connectivity();
+		walkableBoardReady = false;
+		overlapVersion++;
+		flowFields.clear();
+		overlapChanged = reserveChanged = neutralChanged = true;
+	}
+
+	void Map::addOverlap(const TilePosition t, const int w, const int h, const Owner owner)
+	{
+		overlapChanged = true;
 		for (auto x = t.x; x < t.x + w; x++)
 		{
 			for (auto y = t.y; y < t.y + h; y++)
 			{
+				if (!TilePosition(x, y).isValid())
+					continue;
 				overlapGrid[x][y] = 1;
+				addOwner(ownerGrid, layerGrid, x, y, owner);
+			}
+		}
+		occupancyChanged(t, w, h);
+	}
+
+	void Map::removeOverlap(const int x, const int y, const OwnerType type)
+	{
+		// The tile stays overlapped while another layer is left on it, and that layer becomes the owner if the removed one was
+		if (!layerGrid.contains(x, y))
+			return;
+		if (removeOwner(ownerGrid, layerGrid, x, y, type))
+			ownerGrid[x][y] = findOwner(TilePosition(x, y), layerGrid[x][y]);
+		if (layerGrid[x][y] == 0)
+			overlapGrid[x][y] = 0;
+	}
+
+	Owner Map::findOwner(const TilePosition here, const LayerMask layers) const
+	{
+		const auto inside = [&](const TilePosition tile, const TilePosition size) {
+			return here.x >= tile.x && here.y >= tile.y && here.x < tile.x + size.x && here.y < tile.y + size.y;
+		};
+
+		// Same order the layers are laid out in onStart, so the owner is the one a fresh layout would have recorded
+		if (layers & (layerBit(OwnerType::Station) | layerBit(OwnerType::StationDefense) | layerBit(OwnerType::Mining) | layerBit(OwnerType::Reserved))) {
+			for (auto& station : stations) {
+				for (auto& defense : station.DefenseLocations()) {
+					if (inside(defense, { 2, 2 }))
+						return { OwnerType::StationDefense, station.Id() };
+				}
+				if (inside(station.BWEMBase()->Location(), { 4, 3 }))
+					return { OwnerType::Station, station.Id() };
+				const TilePosition start(station.ResourceCentroid());
+				if ((layers & (layerBit(OwnerType::Mining) | layerBit(OwnerType::Reserved))) && inside(start - TilePosition(4, 4), { 8, 8 })) {
+					if (here.getDistance(start) < 3)
+						return { OwnerType::Mining, station.Id() };
+					if (here.getDistance(start) < 4)
+						return { OwnerType::Reserved, station.Id() };
+				}
+			}
+		}
+		if (layers & (layerBit(OwnerType::Wall) | layerBit(OwnerType::WallDefense))) {
+			for (auto& wall : walls) {
+				const auto& slots = wall.getSlots();
+				for (size_t i = 0; i < slots.size(); i++) {
+					if (inside(slots.tile(i), footprintSize(slots.footprint(i))))
+						return { slots.footprint(i) == Footprint::Defense ? OwnerType::WallDefense : OwnerType::Wall, wall.getId() };
+				}
+			}
+		}
+		if (layers & layerBit(OwnerType::Block)) {
+			for (auto& block : blocks) {
+				if (inside(block.Location(), { block.width(), block.height() }))
+					return { OwnerType::Block, block.Id() };
+			}
+		}
+		if ((layers & layerBit(OwnerType::Neutral)) && neutralGrid[here.x][here.y].id >= 0)
+			return { OwnerType::Neutral, neutralGrid[here.x][here.y].id };
+		return Owner();
+	}
+
+	bool Map::isOpen(const TilePosition here) const
+	{
+		return layerGrid.contains(here.x, here.y) && isWalkable(here) && (layerGrid[here.x][here.y] & solidLayers) == 0 && usedTiles.find(here) == usedTiles.end();
+	}
+
+	TilePosition Map::openTileNear(const TilePosition here) const
+	{
+		// Closest open tile within a few tiles, stations and chokes sit on or next to tiles that get closed
+		auto distBest = DBL_MAX;
+		auto tileBest = TilePositions::Invalid;
+		for (auto x = here.x - 6; x <= here.x + 6; x++) {
+			for (auto y = here.y - 6; y <= here.y + 6; y++) {
+				const TilePosition t(x, y);
+				if (!t.isValid() || connectivity.label(t) == 0)
+					continue;
+				const auto dist = t.getDistance(here);
+				if (dist < distBest)
+					distBest = dist, tileBest = t;
 			}
 		}
+		return tileBest;
+	}
+
+	void Map::buildConnectivity()
+	{
+		connectivity.build(game->mapWidth(), game->mapHeight(), [&](const TilePosition t) { return isOpen(t); });
+
+		connectKeys.clear();
+		for (auto tile : { TilePosition(mainPosition), TilePosition(naturalPosition) })
+			connectKeys.push_back(openTileNear(tile));
+		for (auto choke : { mainChoke, naturalChoke }) {
+			if (choke)
+				connectKeys.push_back(openTileNear(TilePosition(choke->Center())));
+		}
+		connectKeys.erase(remove(connectKeys.begin(), connectKeys.end(), TilePositions::Invalid), connectKeys.end());
+	}
+
+	void Map::updateConnectivity(const TilePosition here, const int width, const int height)
+	{
+		if (!connectivity.built())
+			return;
+		connectivity.update(here, width, height, [&](const TilePosition t) { return isOpen(t); });
+
+		// A key that was built over moves to the closest tile that is still open
+		for (auto& key : connectKeys) {
+			if (connectivity.label(key) == 0)
+				key = openTileNear(key);
+		}
+		connectKeys.erase(remove(connectKeys.begin(), connectKeys.end(), TilePositions::Invalid), connectKeys.end());
+	}
+
+	void Map::occupancyChanged(const TilePosition here, const int width, const int height)
+	{
+		overlapVersion++;
+		updateConnectivity(here, width, height);
+		for (auto& field : flowFields)
+			field.second->invalidate(here, width, height);
+	}
+
+	bool Map::isFlowOpen(const TilePosition here) const
+	{
+		return overlapGrid.contains(here.x, here.y) && isWalkable(here) && overlapGrid[here.x][here.y] == 0 && usedTiles.find(here) == usedTiles.end();
+	}
+
+	const FlowField* Map::getFlowField(vector<TilePosition> goals)
+	{
+		ScopedTimer timer(stats, Timer::GetFlowField);
+		if (busy(Subsystem::Blocks) || !gridsSized())
+			return nullptr;
+
+		// The same goals in any order share one field
+		sort(goals.begin(), goals.end());
+		goals.erase(unique(goals.begin(), goals.end()), goals.end());
+		goals.erase(remove_if(goals.begin(), goals.end(), [](const TilePosition t) { return !t.isValid(); }), goals.end());
+		if (goals.empty())
+			return nullptr;
+
+		const auto open = [&](const TilePosition t) { return isFlowOpen(t); };
+		auto& field = flowFields[goals];
+		if (!field) {
+			field = make_unique<FlowField>();
+			field->build(game->mapWidth(), game->mapHeight(), goals, open);
+		}
+		else if (field->isDirty())
+			field->repair(open);
+		return field.get();
+	}
+
+	const FlowField* Map::getFlowField(const Wall& wall)
+	{
+		return getFlowField(vector<TilePosition>{ wall.getDoor() });
+	}
+
+	const FlowField* Map::getFlowField(const Station& station)
+	{
+		return getFlowField(vector<TilePosition>(station.DefenseLocations().begin(), station.DefenseLocations().end()));
+	}
+
+	const FlowField* Map::getFlowField(const BWEM::ChokePoint * choke)
+	{
+		if (!choke)
+			return nullptr;
+		vector<TilePosition> goals;
+		for (auto& w : choke->Geometry())
+			goals.push_back(TilePosition(w));
+		return getFlowField(goals);
+	}
+
+	bool Map::keepsConnected(const TilePosition here, const int width, const int height)
+	{
+		if (busy(Subsystem::Stations))
+			return false;
+		return connectivity.keepsConnected(here, width, height, connectKeys);
+	}
+
+	bool Map::overlapsLayer(const TilePosition here, const OwnerType type) const
+	{
+		return layerGrid.contains(here.x, here.y) && (layerGrid[here.x][here.y] & layerBit(type)) != 0;
+	}
+
+	void Map::publish()
+	{
+		const auto current = getSnapshot();
+		if (current && !blocksChanged && !wallsChanged && !stationsChanged && !overlapChanged && !reserveChanged && !neutralChanged && !usedTilesChanged && !slotsChanged)
+			return;
+
+		// Anything that didn't change is shared with the previous snapshot
+		shared_ptr<Snapshot> next(new Snapshot());
+		next->version = current ? current->version + 1 : 1;
+		next->game = game;
+		next->blocks = (current && !blocksChanged) ? current->blocks : make_shared<const vector<Block>>(blocks);
+		next->walls = (current && !wallsChanged) ? current->walls : make_shared<const vector<Wall>>(walls);
+		next->stations = (current && !stationsChanged) ? current->stations : make_shared<const vector<Station>>(stations);
+		next->reserve = (current && !reserveChanged) ? current->reserve : make_shared<const BitGrid>(reserveGrid);
+		next->neutral = (current && !neutralChanged) ? current->neutral : make_shared<const Grid<NeutralTile>>(neutralGrid);
+		next->usedTiles = (current && !usedTilesChanged) ? current->usedTiles : make_shared<const set<TilePosition>>(usedTiles);
+
+		if (current && !overlapChanged)
+			next->occupancy = current->occupancy;
+		else {
+			auto occupancy = make_shared<Snapshot::Occupancy>();
+			occupancy->overlap = overlapGrid;
+			occupancy->owner = ownerGrid;
+			occupancy->layer = layerGrid;
+			next->occupancy = occupancy;
+		}
+
+		if (current && !slotsChanged)
+			next->slots = current->slots;
+		else {
+			auto slots = make_shared<Snapshot::Slots>();
+			slots->smallSlots = smallSlots, slots->mediumSlots = mediumSlots, slots->largeSlots = largeSlots, slots->defenseSlots = defenseSlots;
+			next->slots = slots;
+		}
+
+		next->mainTile = mainTile, next->naturalTile = naturalTile;
+		next->mainArea = mainArea, next->naturalArea = naturalArea;
+		next->mainChoke = mainChoke, next->naturalChoke = naturalChoke;
+
+		blocksChanged = wallsChanged = stationsChanged = false;
+		overlapChanged = reserveChanged = neutralChanged = usedTilesChanged = slotsChanged = false;
+		publishedFrame = game->getFrameCount();
+		atomic_store(&published, shared_ptr<const Snapshot>(next));
+	}
+
+	void Map::publishLater()
+	{
+		// Unit events come in bursts, the first one of a frame publishes and the rest wait for the next frame or the next query
+		if (game->getFrameCount() != publishedFrame)
+			publish();
+	}
+
+	shared_ptr<const Snapshot> Map::getSnapshot() const
+	{
+		return atomic_load(&published);
 	}
 
 	Map* Map::BWEBInstance = nullptr;
 
 	Map & Map::Instance()
 	{
-		if (!BWEBInstance) BWEBInstance = new Map(BWEM::Map::Instance());
+		if (!BWEBInstance) BWEBInstance = new Map(BWEM::Map::Instance(), BroodwarPtr);
 		return *BWEBInstance;
 	}
 }
\ No newline at end of file
@@ -1,9 +1,25 @@
 #pragma once
 #pragma warning(disable : 4351)
 #include <set>
+#include <climits>
+#include <memory>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <tuple>
 
 #include <BWAPI.h>
 #include <bwem.h>
+#include "SlotBuffer.h"
+#include "Grid.h"
+#include "Owner.h"
+#include "Stats.h"
+#include "Scheduler.h"
+#include "Connectivity.h"
+#include "FlowField.h"
+#include "BitBoard.h"
 #include "Station.h"
 #include "Block.h"
 #include "Wall.h"
@@ -16,6 +32,32 @@ namespace BWEB
 	class Block;
 	class Wall;
 	class Station;
+	class Snapshot;
+
+	// Kind of neutral that covers a tile
+	enum class NeutralType : unsigned char { None, Mineral, Geyser, StaticBuilding, Other };
+
+	// The neutral covering a tile, id is the BWAPI id of the neutral Unit
+	struct NeutralTile
+	{
+		NeutralType type = NeutralType::None;
+		int id = -1;
+	};
+
+	// Parts of the layout that become ready one after the other when onStartAsync is used
+	enum class Subsystem : unsigned char { Stations, Walls, Blocks, Count };
+
+	// How placement queries measure how close a slot is to the search center
+	enum class Distance : unsigned char { Air, Ground };
+
+	// One building of a getBuildPositions batch, defenses are placed with getDefBuildPosition
+	struct BuildRequest
+	{
+		UnitType type;
+		TilePosition searchCenter = TilePositions::None;
+		bool defense = false;
+	};
+
 	class Map
 	{
 	private:
@@ -23,10 +65,12 @@ namespace BWEB
 		vector<Station> stations;
 		vector<Wall> walls;
 		vector<Block> blocks;
+		const vector<Station> noStations;
+		const vector<Wall> noWalls;
+		const vector<Block> noBlocks;
 		
 		// Blocks
-		// TODO: Add this function. This would be used to create a block that makes room for a specific type (possibly better generation than floodfill)
-		// void createBlock(BWAPI::Race, UnitType, BWEM::Area const *, TilePosition);
+		bool packBlock(const vector<UnitType>&, int, int, vector<pair<TilePosition, UnitType>>&);
 		void insertBlock(BWAPI::Race, TilePosition, int, int);
 		void findStartBlock();
 		void findStartBlock(BWAPI::Player);
@@ -45,18 +89,45 @@ namespace BWEB
 		void insertTechBlock(BWAPI::Race, TilePosition, bool, bool);
 		map<const BWEM::Area *, int> typePerArea;
 
+		// Blocks are generated per area, either all at once or lazily as areas are used
+		void generateBlocks(BWAPI::Race, TilePosition, TilePosition, const BWEM::Area * = nullptr);
+		void regenerateBlocks();
+
+		// One pass of generateBlocks, kept between steps so it can be spread over frames
+		struct BlockPass
+		{
+			BWAPI::Race race;
+			TilePosition topLeft;
+			vector<TilePosition> tiles;
+			vector<int> heights, widths;
+			int width = 20, height = 20;
+			size_t next = 0;
+		};
+		BlockPass beginBlocks(BWAPI::Race, TilePosition, TilePosition, const BWEM::Area * = nullptr);
+		bool stepBlocks(BlockPass&, size_t tiles);
+		bool lazyBlocks = false;
+		BWAPI::Race blockRace = Races::None;
+		set<const BWEM::Area *> areasWithBlocks;
+		vector<pair<TilePosition, TilePosition>> dirtyRegions;
+
 		// Walls
 		bool isWallTight(UnitType, TilePosition);
 		bool isPoweringWall(TilePosition);
-		bool iteratePieces();
+		bool beginWall(const vector<UnitType>&, const BWEM::Area *, const BWEM::ChokePoint *, UnitType, const vector<UnitType>&, bool, bool);
+		bool stepWall();
+		void finishWall();
+		void setupPieces();
+		void findWallAnchors();
+		void orderCandidates(UnitType, vector<TilePosition>&);
+		vector<double>& historyOf(UnitType);
 		bool checkPiece(TilePosition);
 		bool testPiece(TilePosition);
 		bool placePiece(TilePosition);
 		bool identicalPiece(TilePosition, UnitType, TilePosition, UnitType);
 		void findCurrentHole(bool ignoreOverlap = false);
+		vector<TilePosition> findWallPath(TilePosition, TilePosition, bool ignoreOverlap);
 		void addWallDefenses(const vector<UnitType>& type, Wall& wall);
-		int reserveGrid[256][256] = {};
-		int testGrid[256][256] = {};
+		BitGrid reserveGrid;
 
 		double bestWallScore = 0.0, closest = DBL_MAX;
 		TilePosition currentHole, startTile, endTile;
@@ -72,16 +143,43 @@ namespace BWEB
 		const BWEM::ChokePoint * choke{};
 		const BWEM::Area * area{};
 		BWEM::Map& mapBWEM;
+		BWAPI::Game * game;
 		UnitType tight;
 		bool reservePath{};
 		bool requireTight;
 		int chokeWidth;
 		TilePosition wallBase;
+		vector<UnitType> wallDefenses;
+
+		// Bitboards for the path checks of the wall search, terrain is read once per map and overlap again only after it changed
+		BitBoard walkableBoard, overlapBoard, passableBoard;
+		BitSearch wallPathSearch, wallPathBack;
+		bool walkableBoardReady = false;
+		uint32_t overlapVersion = 0, overlapBoardVersion = UINT32_MAX;
+
+		// Tiles the first piece of each type can start from, found once per Wall
+		map<UnitType, vector<TilePosition>> wallAnchors;
+
+		// Move ordering, the orderings of pieces left to try and how well every placement did in finished walls so far
+		vector<vector<UnitType>> wallOrders;
+		vector<UnitType> bestOrder;
+		struct RankedTile { bool killer; double history, distance; TilePosition tile; };
+		static constexpr double wallHistoryCap = 1e6;
+		map<UnitType, vector<double>> wallHistory;
+		vector<RankedTile> wallRanked;
+		int wallHistoryWidth = 0;
+		TilePosition wallChokeTile;
+		uint64_t wallNodes = 0, bestWallNode = 0;
+
+		// Search state between steps of a Wall
+		TilePosition wallStart;
+		int wallId = 0;
+		bool wallSearching = false;
 
 		// TilePosition grid of what has been visited for wall placement
 		struct VisitGrid
 		{
-			int location[256][256] = {};
+			Grid<uint8_t> location;
 		};
 		map<UnitType, VisitGrid> visited;
 		bool parentSame{}, currentSame{};
@@ -96,53 +194,253 @@ namespace BWEB
 		const BWEM::ChokePoint * naturalChoke{};
 		const BWEM::ChokePoint * mainChoke{};
 		set<TilePosition> usedTiles;
-		void addOverlap(TilePosition, int, int);
-		bool isPlaceable(UnitType, TilePosition);
+		Grid<NeutralTile> neutralGrid;
+		void removeNeutral(Unit);
+
+		// A neutral as onStart rasterizes it, copied out of BWAPI and BWEM so the analysis thread never reads live units
+		struct NeutralUnit
+		{
+			int id;
+			UnitType type;
+			TilePosition tile;
+			NeutralType neutralType;
+		};
+		static NeutralUnit neutralOf(Unit, NeutralType);
+		vector<NeutralUnit> captureNeutrals() const;
+		void addNeutral(const NeutralUnit&);
+		void analyze(const vector<NeutralUnit>&);
+		bool clearOfResources(UnitType, TilePosition) const;
+		void addOverlap(TilePosition, int, int, Owner = Owner());
+		void removeOverlap(int, int, OwnerType);
+		bool isPlaceable(UnitType, TilePosition) const;
+
+		// Layered occupancy: the first owner of every tile and a bit for every kind of owner on it
+		Grid<Owner> ownerGrid;
+		Grid<LayerMask> layerGrid;
+		void sizeGrids();
+		bool gridsSized() const { return overlapGrid.width() > 0; }
+		Owner findOwner(TilePosition, LayerMask) const;
+		bool overlapsLayer(TilePosition, OwnerType) const;
+
+		// Components of the tiles units can still walk through, and the tiles that have to stay connected
+		Connectivity connectivity;
+		vector<TilePosition> connectKeys;
+		bool keepConnected = false;
+		bool isOpen(TilePosition) const;
+		TilePosition openTileNear(TilePosition) const;
+		void buildConnectivity();
+		void updateConnectivity(TilePosition, int, int);
+
+		// Flow fields by their goal tiles, repaired the next time they are asked for after the tiles under them changed
+		map<vector<TilePosition>, unique_ptr<FlowField>> flowFields;
+		bool isFlowOpen(TilePosition) const;
+		void occupancyChanged(TilePosition, int, int);
+
+		// Slots per footprint
+		SlotIndex smallSlots{ 2, 2 }, mediumSlots{ 3, 2 }, largeSlots{ 4, 3 }, defenseSlots{ 2, 2 };
+		SlotIndex& blockSlots(Footprint);
+		const SlotIndex& blockSlots(Footprint) const;
+		void insertSlot(SlotIndex&, TilePosition);
+		void eraseSlot(SlotIndex&, TilePosition);
+		void insertSlots(const Block&);
+		void storeBlock(Block&);
+		void eraseSlots(const Block&);
+		void updateSlots(TilePosition, int, int);
+		bool isSlotFree(const SlotIndex&, TilePosition) const;
+		TilePosition closestFreeSlot(const SlotIndex&, UnitType, TilePosition, Distance = Distance::Air) const;
+		TilePosition closestSlotByGround(const SlotIndex&, UnitType, TilePosition) const;
+
+		// Tiles handed out by getBuildPositions, every tile holds the frame its reservation runs out on
+		struct Reservation
+		{
+			TilePosition tile;
+			UnitType type;
+			int expires;
+		};
+		Grid<int> reservationGrid;
+		vector<Reservation> reservations;
+		void reserve(TilePosition, UnitType, int frames);
+		void clearReservation(const Reservation&);
+		void expireReservations();
+
+		// Scratch grids of the ground distance search, stamped so they never need clearing
+		mutable Grid<uint32_t> groundCost, groundSeen;
+		mutable uint32_t groundStamp = 0;
 
 		// Stations
 		void findStations();
-		set<TilePosition>& stationDefenses(BWAPI::Race, TilePosition, bool, bool);
-		set<TilePosition>& stationDefenses(BWAPI::Player, TilePosition, bool, bool);
-		set<TilePosition>& stationDefenses(TilePosition, bool, bool);
-		set<TilePosition> returnValues;
+		set<TilePosition> stationDefenses(BWAPI::Race, TilePosition, bool, bool);
+		set<TilePosition> stationDefenses(BWAPI::Player, TilePosition, bool, bool);
+		set<TilePosition> stationDefenses(TilePosition, bool, bool);
+
+		// Snapshots, only the parts that changed since the last one are copied and unit events publish at most once per frame
+		shared_ptr<const Snapshot> published;
+		bool blocksChanged = true, wallsChanged = true, stationsChanged = true;
+		bool overlapChanged = true, reserveChanged = true, neutralChanged = true, usedTilesChanged = true, slotsChanged = true;
+		int publishedFrame = -1;
+		void publish();
+		void publishLater();
+
+		// Start location and race the layout is made for, our own unless overridden
+		TilePosition perspectiveStart = TilePositions::None;
+		BWAPI::Race perspectiveRace = Races::None;
+		TilePosition startLocation() const;
+		BWAPI::Race selfRace() const;
+
+		// Draw lists, rebuilt when a new snapshot is published and bucketed in cells of 8x8 tiles so drawing only visits what is on screen
+		struct DrawShape
+		{
+			enum Kind : unsigned char { Box, SolidBox, Circle, Reserved } kind;
+			Position topLeft, bottomRight;
+		};
+		static const int drawCellSize = 256;
+		vector<DrawShape> drawCells[32][32];
+		unsigned long long drawVersion = 0;
+		void buildDrawLists();
+
+		// Layouts made from the other start locations
+		map<TilePosition, unique_ptr<Map>> layouts;
+
+		// Background analysis, every subsystem is ready unless onStartAsync is still working on it
+		future<void> analysis;
+		atomic<bool> ready[int(Subsystem::Count)] = { {true}, {true}, {true} };
+		shared_future<void> readyFutures[int(Subsystem::Count)];
+		atomic<thread::id> analysisThread{};
+		int analysisFrame = 0;
+		vector<function<void()>> pendingCalls;
+		bool busy(Subsystem) const;
+		bool onAnalysisThread() const { return analysisThread.load() == this_thread::get_id(); }
+		int frame() const { return onAnalysisThread() ? analysisFrame : game->getFrameCount(); }
+		bool deferWhileBusy(function<void()> call);
+		void flushPending();
+
+		// Jobs the bot spreads over frames with update
+		Scheduler scheduler;
+		void queueDirtyRegions();
+		void queueBlockPasses(vector<tuple<TilePosition, TilePosition, const BWEM::Area *>>, Priority);
+
+		// Instrumentation, disabled until enableStats is called
+		mutable Stats stats;
 
 		// General
 		static Map* BWEBInstance;
+		int nextId = 0;
 
 	public:
-		Map(BWEM::Map& map);
+		/// <summary> <para> Creates a BWEB::Map for one game, any number of them can exist side by side. </para>
+		/// <para> Note: Everything BWEB knows about the game comes from the BWEM::Map and BWAPI::Game passed in here. </para></summary>
+		/// <param name="map"> The BWEM::Map of the game, it must be initialized before onStart. </param>
+		/// <param name="game"> The BWAPI::Game to read terrain, players and units from. </param>
+		Map(BWEM::Map& map, BWAPI::Game * game = BroodwarPtr);
 		void draw(), onStart(), onUnitDiscover(Unit), onUnitDestroy(Unit), onUnitMorph(Unit);
 		static Map &Instance();
-		int overlapGrid[256][256] = {};
+		Grid<uint8_t> overlapGrid;
 
 		/// This is just put here so AStar can use it for now
-		UnitType overlapsCurrentWall(TilePosition tile, int width = 1, int height = 1);
+		UnitType overlapsCurrentWall(TilePosition tile, int width = 1, int height = 1) const;
 
 		//vector<TilePosition> findBuildableBorderTiles(const BWEM::Map &, WalkPosition, const BWEM::Area *);
-		bool overlapsBlocks(TilePosition);
-		bool overlapsStations(TilePosition);
-		bool overlapsNeutrals(TilePosition);
-		bool overlapsMining(TilePosition);
-		bool overlapsWalls(TilePosition);
-		bool overlapsAnything(TilePosition here, int width = 1, int height = 1, bool ignoreBlocks = false);
-		static bool isWalkable(TilePosition);
-		int tilesWithinArea(BWEM::Area const *, TilePosition here, int width = 1, int height = 1);
+		bool overlapsBlocks(TilePosition) const;
+		bool overlapsStations(TilePosition) const;
+		bool overlapsNeutrals(TilePosition) const;
+		bool overlapsMining(TilePosition) const;
+
+		/// <summary> Returns a handle to the BWEB object that owns the given TilePosition, the type is OwnerType::None if nothing owns it. </summary>
+		Owner getOwner(TilePosition here) const { return !busy(Subsystem::Blocks) && ownerGrid.contains(here.x, here.y) ? ownerGrid[here.x][here.y] : Owner(); }
+
+		/// <summary> Returns which neutral Unit, if any, covers the given TilePosition. </summary>
+		NeutralTile getNeutral(TilePosition here) const { return !busy(Subsystem::Stations) && neutralGrid.contains(here.x, here.y) ? neutralGrid[here.x][here.y] : NeutralTile(); }
+		bool overlapsWalls(TilePosition) const;
+		bool overlapsAnything(TilePosition here, int width = 1, int height = 1, bool ignoreBlocks = false) const;
+		bool isWalkable(TilePosition here) const { return isWalkable(game, here); }
+		static bool isWalkable(BWAPI::Game *, TilePosition);
+		int tilesWithinArea(BWEM::Area const *, TilePosition here, int width = 1, int height = 1) const;
+
+		/// <summary> Returns true if units can walk from one TilePosition to the other around everything BWEB has placed or seen built. </summary>
+		bool isConnected(TilePosition a, TilePosition b) const { return !busy(Subsystem::Stations) && connectivity.connected(a, b); }
+
+		/// <summary> <para> Returns true if closing the given rectangle keeps the main, the natural and both of their chokes connected to each other. </para>
+		/// <para> Note: Answered from the ring of tiles around the rectangle in most cases, only a rectangle that touches more than one obstacle needs a search. </para></summary>
+		/// <param name="here"> The top left TilePosition of the rectangle. </param>
+		/// <param name="width"> The width of the rectangle in tiles. </param>
+		/// <param name="height"> The height of the rectangle in tiles. </param>
+		bool keepsConnected(TilePosition here, int width, int height);
+
+		/// <summary> <para> Makes every BWEB::Block that is found or created from now on keep the main, the natural and their chokes connected. </para>
+		/// <para> Note: Off by default, Blocks always keep a free border but a row of them can still close off a narrow area. </para></summary>
+		void setKeepConnected(bool keep);
+
+		/// <summary> <para> Returns a flow field toward the closest of the given TilePositions, built the first time it is asked for and kept up to date after. </para>
+		/// <para> Note: Tiles BWEB has laid out or seen built are avoided, the goals themselves are always reachable. The pointer stays valid until onStart is called again. </para></summary>
+		/// <param name="goals"> The TilePositions units should walk to. </param>
+		/// <returns> The field, or nullptr if there are no valid goals or Blocks aren't ready yet. </returns>
+		const FlowField* getFlowField(vector<TilePosition> goals);
+
+		/// <summary> Returns a flow field toward the door of a BWEB::Wall, nullptr if it has no door. </summary>
+		const FlowField* getFlowField(const Wall& wall);
+
+		/// <summary> Returns a flow field toward the defenses of a BWEB::Station. </summary>
+		const FlowField* getFlowField(const Station& station);
+
+		/// <summary> Returns a flow field toward any tile across a BWEM::ChokePoint, such as getNaturalChoke(). </summary>
+		const FlowField* getFlowField(const BWEM::ChokePoint * choke);
+
+		/// <summary> <para> Returns the latest immutable snapshot of the layout. </para>
+		/// <para> Note: A snapshot never changes once published, so any number of threads can query it without locks while the game thread keeps updating BWEB.
+		/// Unit events publish at most once per frame, what later events of a frame changed shows up with the next frame's first event, update or placement query. </para></summary>
+		shared_ptr<const Snapshot> getSnapshot() const;
+
+		/// <summary> <para> Turns latency histograms and search node counters on or off, they are off by default. </para>
+		/// <para> Note: While off, every instrumented call only pays for one relaxed atomic load. </para></summary>
+		void enableStats(bool enable) { stats.setEnabled(enable); }
+
+		/// <summary> Returns the call count and latency histogram of a BWEB call, use percentileMs on it to get p50 or p99 latency. </summary>
+		TimerStats getStats(Timer timer) const { return stats.get(timer); }
+
+		/// <summary> Returns how many nodes a search has expanded since stats were enabled or last reset. </summary>
+		uint64_t getStats(Counter counter) const { return stats.get(counter); }
+
+		/// <summary> Clears every latency histogram and node counter. </summary>
+		void resetStats() { stats.reset(); }
 
 		/// <summary> Returns the closest buildable TilePosition for any type of structure </summary>
 		/// <param name="type"> The UnitType of the structure you want to build.</param>
-		/// <param name="tile"> The TilePosition you want to build closest to.</param>
-		TilePosition getBuildPosition(UnitType type, TilePosition searchCenter = Broodwar->self()->getStartLocation());
+		/// <param name="tile"> The TilePosition you want to build closest to, defaults to the start location.</param>
+		/// <param name="distance"> (Optional) Distance::Ground ranks slots by how far they are to walk instead of in a straight line, so slots across a cliff lose out.
+		/// The walk is searched up to twice the straight line distance of the closest slot (at least 32 tiles), that slot is returned if nothing is found within it. </param>
+		TilePosition getBuildPosition(UnitType type, TilePosition searchCenter = TilePositions::None, Distance distance = Distance::Air);
+
+		/// <summary> <para> Same as getBuildPosition for a Map you can't change, such as a layout from getLayout. </para>
+		/// <para> Note: Nothing is kept up to date first, queued unit events, lazy Blocks and refills wait for the next non-const query or update. </para></summary>
+		TilePosition getBuildPosition(UnitType type, TilePosition searchCenter = TilePositions::None, Distance distance = Distance::Air) const;
 
 		/// <summary> Returns the closest buildable TilePosition for a defensive structure </summary>
 		/// <param name="type"> The UnitType of the structure you want to build.</param>
-		/// <param name="tile"> The TilePosition you want to build closest to. </param>
-		TilePosition getDefBuildPosition(UnitType type, TilePosition tile = Broodwar->self()->getStartLocation());
+		/// <param name="tile"> The TilePosition you want to build closest to, defaults to the start location. </param>
+		/// <param name="distance"> (Optional) Distance::Ground ranks slots by how far they are to walk instead of in a straight line. </param>
+		TilePosition getDefBuildPosition(UnitType type, TilePosition tile = TilePositions::None, Distance distance = Distance::Air);
+
+		/// <summary> Same as getDefBuildPosition for a Map you can't change, such as a layout from getLayout. </summary>
+		TilePosition getDefBuildPosition(UnitType type, TilePosition tile = TilePositions::None, Distance distance = Distance::Air) const;
+
+		/// <summary> <para> Finds a TilePosition for every building of a build order at once, no two of them overlap. </para>
+		/// <para> Note: Every returned TilePosition is reserved until the building shows up or the reservation runs out, no other placement query returns it in the meantime.
+		/// Only the placement queries skip reserved slots, isPlaceable and the Wall search don't, and a Snapshot sees the reservations that existed when it was published. </para></summary>
+		/// <param name="requests"> The buildings to place, in the order they should pick their slots. </param>
+		/// <param name="frames"> (Optional) How many frames each reservation lasts, at least 1. </param>
+		/// <param name="distance"> (Optional) How slots are ranked, see getBuildPosition. </param>
+		/// <returns> One TilePosition per request, TilePositions::Invalid where nothing was free. </returns>
+		vector<TilePosition> getBuildPositions(const vector<BuildRequest>& requests, int frames = 240, Distance distance = Distance::Air);
+
+		/// <summary> Drops the reservation of a TilePosition returned by getBuildPositions, if you decide not to build there. </summary>
+		/// <param name="here"> The TilePosition that was returned. </param>
+		void releaseReservation(TilePosition here);
 
 		template <class PositionType>
 		/// <summary> Returns the estimated ground distance from one Position type to another Position type.</summary>
 		/// <param name="first"> The first Position. </param>
 		/// <param name="second"> The second Position. </param>
-		double getGroundDistance(PositionType start, PositionType end);
+		double getGroundDistance(PositionType start, PositionType end) const;
 
 		/// <summary> <para> Returns a pointer to a BWEB::Wall if it has been created in the given BWEM::Area and BWEM::ChokePoint. </para>
 		/// <para> Note: If you only pass a BWEM::Area or a BWEM::ChokePoint (not both), it will imply and pick a BWEB::Wall that exists within that Area or blocks that BWEM::ChokePoint. </para></summary>
@@ -154,25 +452,35 @@ namespace BWEB
 		Station* getStation(BWEM::Area const* area);
 
 		/// <summary> Returns the BWEM::Area of the natural expansion </summary>
-		const BWEM::Area * getNaturalArea() const { return naturalArea; }
+		const BWEM::Area * getNaturalArea() const { return busy(Subsystem::Stations) ? nullptr : naturalArea; }
 
 		/// <summary> Returns the BWEM::Area of the main </summary>
-		const BWEM::Area * getMainArea() const { return mainArea; }
+		const BWEM::Area * getMainArea() const { return busy(Subsystem::Stations) ? nullptr : mainArea; }
 
 		/// <summary> Returns the BWEM::Chokepoint of the natural </summary>
-		const BWEM::ChokePoint * getNaturalChoke() const { return naturalChoke; }
+		const BWEM::ChokePoint * getNaturalChoke() const { return busy(Subsystem::Stations) ? nullptr : naturalChoke; }
 
 		/// <summary> Returns the BWEM::Chokepoint of the main </summary>
-		const BWEM::ChokePoint * getMainChoke() const { return mainChoke; }
+		const BWEM::ChokePoint * getMainChoke() const { return busy(Subsystem::Stations) ? nullptr : mainChoke; }
 
 		/// <summary> Returns a vector containing every BWEB::Wall. </summary>
-		vector<Wall> getWalls() const { return walls; }
+		const vector<Wall>& getWalls() const { return busy(Subsystem::Walls) ? noWalls : walls; }
 
 		/// <summary> Returns a vector containing every BWEB::Block </summary>
-		vector<Block> Blocks() const { return blocks; }
+		const vector<Block>& Blocks() const { return busy(Subsystem::Blocks) ? noBlocks : blocks; }
 
 		/// <summary> Returns a vector containing every BWEB::Station </summary>
-		vector<Station> Stations() const { return stations; }
+		const vector<Station>& Stations() const { return busy(Subsystem::Stations) ? noStations : stations; }
+
+		/// <summary> <para> Returns the BWEB::Block with the given id, or nullptr if it was erased. </para>
+		/// <para> Note: Pointers into Blocks() move when a Block is erased, hold on to the id instead. </para></summary>
+		const Block* getBlockById(int id) const;
+
+		/// <summary> Returns the BWEB::Wall with the given id, or nullptr if there is none. </summary>
+		const Wall* getWallById(int id) const;
+
+		/// <summary> Returns the BWEB::Station with the given id, or nullptr if there is none. </summary>
+		const Station* getStationById(int id) const;
 
 		/// <summary> Returns the closest BWEB::Station to the given TilePosition. </summary>
 		const Station* getClosestStation(TilePosition) const;
@@ -184,10 +492,10 @@ namespace BWEB
 		const Block* getClosestBlock(TilePosition) const;
 
 		/// Returns the TilePosition of the natural expansion
-		TilePosition getNatural() const { return naturalTile; }
+		TilePosition getNatural() const { return busy(Subsystem::Stations) ? TilePositions::Invalid : naturalTile; }
 
 		/// Returns the TilePosition of the main
-		TilePosition getMain() const { return mainTile; }
+		TilePosition getMain() const { return busy(Subsystem::Stations) ? TilePositions::Invalid : mainTile; }
 
 		/// Returns the set of used TilePositions
 		set<TilePosition>& getUsedTiles() { return usedTiles; }
@@ -204,12 +512,70 @@ namespace BWEB
 		/// <param name="requireTight"> Optional parameter to ensure that the Wall must be walltight. </param>
 		void createWall(vector<UnitType>& buildings, const BWEM::Area * area, const BWEM::ChokePoint * choke, UnitType tight = UnitTypes::None, const vector<UnitType>& defenses = {}, bool reservePath = false, bool requireTight = false);
 
+		/// <summary> <para> Queues a BWEB::Wall to be created by update, a step at a time, instead of all at once. </para>
+		/// <para> Note: Takes the same parameters as createWall, the Wall shows up in getWalls once its search is done. </para></summary>
+		/// <param name="priority"> (Optional) Queued jobs with a higher Priority start first. </param>
+		void queueWall(const vector<UnitType>& buildings, const BWEM::Area * area, const BWEM::ChokePoint * choke, UnitType tight = UnitTypes::None, const vector<UnitType>& defenses = {}, bool reservePath = false, bool requireTight = false, Priority priority = Priority::Normal);
+
 		/// <summary> Adds a UnitType to a currently existing BWEB::Wall. </summary>
 		/// <param name="type"> The UnitType you want to place at the BWEB::Wall. </param>
 		/// <param name="area"> The BWEB::Wall you want to add to. </param>
 		/// <param name="tight"> (Optional) Decides whether this addition to the BWEB::Wall intends to be walled around a specific UnitType. Defaults to none. </param>
 		void addToWall(UnitType type, Wall& wall, UnitType tight = UnitTypes::None);
 
+		/// <summary> <para> Creates the most compact BWEB::Block that fits every UnitType given, placed as close as possible to a TilePosition within a BWEM::Area. </para>
+		/// <para> Note: The Block keeps a free border like every other Block so units are never trapped by it. </para></summary>
+		/// <param name="types"> A Vector of UnitTypes that you want the BWEB::Block to have room for, the same UnitType can be passed in more than once. </param>
+		/// <param name="area"> The BWEM::Area that you want the BWEB::Block to be contained within. </param>
+		/// <param name="here"> The TilePosition you want the BWEB::Block to be closest to. </param>
+		/// <returns> A pointer to the new BWEB::Block, or nullptr if no Block could be placed or Blocks aren't ready yet. </returns>
+		const Block* createBlock(const vector<UnitType>& types, const BWEM::Area * area, TilePosition here);
+
+		/// <summary> <para> Lays out BWEB as if we started at the given start location with the given race, call it before onStart. </para>
+		/// <para> Note: Meant for precomputing layouts of other start locations and races, BWEB uses our own start location and race by default. </para></summary>
+		/// <param name="start"> The start location to lay out the main and natural for. </param>
+		/// <param name="race"> The race to lay out Blocks and Station defenses for. </param>
+		void setPerspective(TilePosition start, BWAPI::Race race);
+
+		/// <summary> <para> Runs onStart, your Walls and findBlocks on a background thread so the game thread never waits on them. </para>
+		/// <para> Note: Until a Subsystem is ready, queries that need it return a fallback: false, nullptr, TilePositions::Invalid, an empty path or an empty vector.
+		/// Unit events and calls that change the layout (createWall, queueWall, eraseBlock, findBlocks of an Area, setKeepConnected) are queued and replayed once Blocks are ready,
+		/// createBlock returns nullptr until then. getSnapshot is always safe and fills in as the analysis goes.
+		/// The neutrals are read from the game before it returns, the thread itself only reads terrain, so the game can keep stepping frames. </para></summary>
+		/// <param name="walls"> (Optional) Called on the background thread after Stations are ready, create your Walls here, don't read the game's units from it. </param>
+		void onStartAsync(const function<void(Map&)>& walls = nullptr);
+
+		/// <summary> Returns true once the given Subsystem can be queried, always true if onStartAsync wasn't used. </summary>
+		bool isReady(Subsystem subsystem) const;
+
+		/// <summary> Returns a future that becomes ready with the given Subsystem. </summary>
+		shared_future<void> whenReady(Subsystem subsystem) const;
+
+		/// <summary> <para> Lays out BWEB from every other start location as if the given race started there, one thread per start location. </para>
+		/// <para> Note: Call it after onStart, each layout gets its main, natural, chokes, Stations and Blocks, and the Walls your callback makes.
+		/// Every layout reads the game from its own thread while this call waits for them, which is fine for a module DLL but not for the BWAPI client. </para></summary>
+		/// <param name="race"> The race to lay out for, usually the enemy's. </param>
+		/// <param name="walls"> (Optional) Called on every layout before its Blocks are found, create the Walls you expect there.
+		/// It runs on the layout threads, but never on two of them at once. </param>
+		void findLayouts(BWAPI::Race race, const function<void(Map&)>& walls = nullptr);
+
+		/// <summary> Returns the layout made from the given start location by findLayouts, or nullptr if there is none. </summary>
+		/// <param name="start"> The start location you scouted the enemy at. </param>
+		const Map* getLayout(TilePosition start) const;
+
+		/// <summary> <para> Writes the whole layout (Stations, Blocks, Walls and every grid) to a binary file that loadLayout can read in later games. </para>
+		/// <para> Note: Call it once you are done creating Walls and Blocks, the file only holds for the current map, start location and race. </para></summary>
+		/// <param name="path"> The file to write. </param>
+		/// <returns> True if the file was written. </returns>
+		bool saveLayout(const string& path);
+
+		/// <summary> <para> Memory maps a file written by saveLayout and uses it in place of onStart and findBlocks, the grids are copied out of the mapping and the objects rebuilt from its records. </para>
+		/// <para> Note: The file is rejected if it was made for a different map, start location, race or version of BWEB, call onStart as usual when it returns false.
+		/// Reservations are dropped, used tiles are kept since they are buildings of the current game. </para></summary>
+		/// <param name="path"> The file to read. </param>
+		/// <returns> True if the layout was loaded. </returns>
+		bool loadLayout(const string& path);
+
 		/// <summary> Erases any blocks at the specified TilePosition. </summary>
 		/// <param name="here"> The TilePosition that you want to delete any BWEB::Block that exists here. </param>
 		void eraseBlock(TilePosition here);
@@ -219,13 +585,45 @@ namespace BWEB
 		void findBlocks(BWAPI::Race);
 		void findBlocks();
 
-		vector<TilePosition> findPath(BWEM::Map&, BWEB::Map&, const TilePosition, const TilePosition, bool ignoreOverlap = false, bool ignoreWalls = false, bool diagonal = false);
+		/// <summary> <para> Initializes lazy building of BWEB::Blocks, call it instead of findBlocks. </para>
+		/// <para> Only the start Block and the Blocks of the main are built right away, every other BWEM::Area gets its Blocks the first time a Station in it is taken or a build position in it is asked for. </para></summary>
+		void findBlocksLazy(BWAPI::Player);
+		void findBlocksLazy(BWAPI::Race);
+		void findBlocksLazy();
+
+		/// <summary> Builds the BWEB::Blocks of a BWEM::Area if they haven't been built yet. </summary>
+		/// <param name="area"> The BWEM::Area that you want BWEB::Blocks in. </param>
+		void findBlocks(const BWEM::Area * area);
+
+		/// <summary> Queues the BWEB::Blocks of a BWEM::Area to be built by update, a few tiles at a time. </summary>
+		/// <param name="area"> The BWEM::Area that you want BWEB::Blocks in. </param>
+		/// <param name="priority"> (Optional) Queued jobs with a higher Priority start first. </param>
+		void queueBlocks(const BWEM::Area * area, Priority priority = Priority::Low);
+
+		/// <summary> <para> Queues your own work to be spread over frames by update, the step is called until it returns true. </para>
+		/// <para> Note: Keep each step short, the budget is only checked between steps. </para></summary>
+		/// <param name="priority"> Queued jobs with a higher Priority start first. </param>
+		/// <param name="step"> Does a little of the work and returns true once all of it is done. </param>
+		void queueJob(Priority priority, function<bool()> step);
+
+		/// <summary> <para> Runs queued BWEB jobs until the budget is spent, call it once per frame. </para>
+		/// <para> Note: Jobs start in Priority order and a started job runs until it is done, the budget is checked between steps so a frame can go over it by one step.
+		/// Blocks freed by erased Blocks or destroyed buildings are also refilled here. </para></summary>
+		/// <param name="budgetMs"> How many milliseconds BWEB may spend this frame. </param>
+		/// <returns> True while queued work remains. </returns>
+		bool update(double budgetMs);
+
+		/// <summary> Returns how many queued jobs are waiting or running. </summary>
+		size_t pendingJobs() const { return scheduler.size(); }
+
+		vector<TilePosition> findPath(BWEM::Map&, const BWEB::Map&, const TilePosition, const TilePosition, bool ignoreOverlap = false, bool ignoreWalls = false, bool diagonal = false) const;
 	};
 
 	// This namespace contains functions which could be used for backward compatibility
 	// with existing code.
 	// just put using namespace BWEB::Utils in the header and 
 	// replace all usages of Map::overlapsBlocks with just overlapsBlocks
+	// they always ask Map::Instance(), bots with more than one BWEB::Map should call the Map directly
 	namespace Utils
 	{
 		static bool overlapsBlocks(TilePosition);
@@ -2,88 +2,54 @@
 
 namespace BWEB
 {
-	bool Map::overlapsStations(const TilePosition here)
+	bool Map::overlapsStations(const TilePosition here) const
 	{
-		for (auto& station : Stations())
-		{
-			const auto tile = station.BWEMBase()->Location();
-			if (here.x >= tile.x && here.x < tile.x + 4 && here.y >= tile.y && here.y < tile.y + 3) return true;
-			for (auto& defense : station.DefenseLocations())
-				if (here.x >= defense.x && here.x < defense.x + 2 && here.y >= defense.y && here.y < defense.y + 2) return true;
-		}
-		return false;
+		if (busy(Subsystem::Stations))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsStations);
+		return overlapsLayer(here, OwnerType::Station) || overlapsLayer(here, OwnerType::StationDefense);
 	}
 
-	bool Map::overlapsBlocks(const TilePosition here)
+	bool Map::overlapsBlocks(const TilePosition here) const
 	{
-		for (auto& block : Blocks())
-		{
-			if (here.x >= block.Location().x && here.x < block.Location().x + block.width() && here.y >= block.Location().y && here.y < block.Location().y + block.height()) return true;
-		}
-		return false;
+		if (busy(Subsystem::Blocks))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsBlocks);
+		return overlapsLayer(here, OwnerType::Block);
 	}
 
-	bool Map::overlapsMining(TilePosition here)
+	bool Map::overlapsMining(TilePosition here) const
 	{
-		for (auto& station : Stations())
-			if (here.getDistance(TilePosition(station.ResourceCentroid())) < 3) return true;
-		return false;
+		if (busy(Subsystem::Stations))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsMining);
+		return overlapsLayer(here, OwnerType::Mining);
 	}
 
-	bool Map::overlapsNeutrals(const TilePosition here)
+	bool Map::overlapsNeutrals(const TilePosition here) const
 	{
-		for (auto& m : mapBWEM.Minerals())
-		{
-			const auto tile = m->TopLeft();
-			if (here.x >= tile.x && here.x < tile.x + 2 && here.y >= tile.y && here.y < tile.y + 1) return true;
-		}
-
-		for (auto& g : mapBWEM.Geysers())
-		{
-			const auto tile = g->TopLeft();
-			if (here.x >= tile.x && here.x < tile.x + 4 && here.y >= tile.y && here.y < tile.y + 2) return true;
-		}
-
-		for (auto& n : mapBWEM.StaticBuildings())
-		{
-			const auto tile = n->TopLeft();
-			if (here.x >= tile.x && here.x < tile.x + n->Type().tileWidth() && here.y >= tile.y && here.y < tile.y + n->Type().tileHeight()) return true;
-		}
-
-		for (auto& n : Broodwar->neutral()->getUnits())
-		{
-			const auto tile = n->getInitialTilePosition();
-			if (here.x >= tile.x && here.x < tile.x + n->getType().tileWidth() && here.y >= tile.y && here.y < tile.y + n->getType().tileHeight()) return true;
-		}
-		return false;
+		if (busy(Subsystem::Stations))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsNeutrals);
+		return getNeutral(here).type != NeutralType::None;
 	}
 
-	bool Map::overlapsWalls(const TilePosition here)
+	bool Map::overlapsWalls(const TilePosition here) const
 	{
-		const auto x = here.x;
-		const auto y = here.y;
-
-		for (auto& wall : getWalls())
-		{
-			for (const auto tile : wall.smallTiles())
-				if (x >= tile.x && x < tile.x + 2 && y >= tile.y && y < tile.y + 2) return true;
-			for (const auto tile : wall.mediumTiles())
-				if (x >= tile.x && x < tile.x + 3 && y >= tile.y && y < tile.y + 2) return true;
-			for (const auto tile : wall.largeTiles())
-				if (x >= tile.x && x < tile.x + 4 && y >= tile.y && y < tile.y + 3) return true;
-
-			for (auto& defense : wall.getDefenses())
-				if (here.x >= defense.x && here.x < defense.x + 2 && here.y >= defense.y && here.y < defense.y + 2) return true;
-		}
-		return false;
+		if (busy(Subsystem::Walls))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsWalls);
+		return overlapsLayer(here, OwnerType::Wall) || overlapsLayer(here, OwnerType::WallDefense);
 	}
 
-	bool Map::overlapsAnything(const TilePosition here, const int width, const int height, bool ignoreBlocks)
+	bool Map::overlapsAnything(const TilePosition here, const int width, const int height, bool ignoreBlocks) const
 	{
+		if (busy(Subsystem::Blocks))
+			return false;
+		ScopedTimer timer(stats, Timer::OverlapsAnything);
 		for (auto x = here.x; x < here.x + width; x++) {
 			for (auto y = here.y; y < here.y + height; y++) {
-				TilePosition t(x, y);
-				if (!t.isValid())
+				if (!overlapGrid.contains(x, y))
 					continue;
 				if (overlapGrid[x][y] > 0)
 					return true;
@@ -92,7 +58,7 @@ namespace BWEB
 		return false;
 	}
 
-	bool Map::isWalkable(const TilePosition here)
+	bool Map::isWalkable(BWAPI::Game * game, const TilePosition here)
 	{
 		int cnt = 0;
 		const auto start = WalkPosition(here);
@@ -100,14 +66,14 @@ namespace BWEB
 			for (auto y = start.y; y < start.y + 4; y++) {
 				if (!WalkPosition(x, y).isValid())
 					return false;
-				if (!Broodwar->isWalkable(WalkPosition(x, y)))
+				if (!game->isWalkable(WalkPosition(x, y)))
 					cnt++;
 			}
 		}
 		return cnt <= 1;
 	}
 
-	int Map::tilesWithinArea(BWEM::Area const * area, const TilePosition here, const int width, const int height)
+	int Map::tilesWithinArea(BWEM::Area const * area, const TilePosition here, const int width, const int height) const
 	{
 		auto cnt = 0;
 		for (auto x = here.x; x < here.x + width; x++)
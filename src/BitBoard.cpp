@@ -0,0 +1,112 @@
+#include "BitBoard.h"
+
+namespace BWEB
+{
+	namespace
+	{
+		bool inBounds(const TilePosition t, const int height) { return t.x >= 0 && t.y >= 0 && t.x < BitBoard::maxSize && t.y < height; }
+
+		// The order findPath tries directions in
+		const TilePosition directions[4] = { { 0, 1 }, { 1, 0 }, { -1, 0 }, { 0, -1 } };
+	}
+
+	int BitSearch::search(const BitBoard& passable, const int h, const TilePosition source, const TilePosition target, const int maxDistance)
+	{
+		height = h;
+		reachedCount = 0;
+		visited.clear();
+		if (!inBounds(source, height))
+			return -1;
+
+		frontier.clear(), next.clear();
+		frontier.set(source.x, source.y);
+		visited.set(source.x, source.y);
+		distanceAt(source.x, source.y) = 0;
+		reachedCount = 1;
+		if (source == target)
+			return 0;
+		if (maxDistance <= 0)
+			return -1;
+
+		// Only rows the frontier touches are grown, the band widens by a row on each side per layer
+		auto top = source.y, bottom = source.y;
+		for (uint16_t distance = 1;; distance++) {
+			auto newTop = height, newBottom = -1;
+			for (auto y = max(0, top - 1); y <= min(height - 1, bottom + 1); y++) {
+				const auto current = frontier.row(y);
+				const auto up = y > 0 ? frontier.row(y - 1) : nullptr;
+				const auto down = y < height - 1 ? frontier.row(y + 1) : nullptr;
+				const auto open = passable.row(y);
+				auto seen = visited.row(y);
+				auto out = next.row(y);
+
+				uint64_t rowAny = 0;
+				for (int w = 0; w < BitBoard::rowWords; w++) {
+					auto grown = current[w] << 1 | current[w] >> 1;
+					if (w > 0)
+						grown |= current[w - 1] >> 63;
+					if (w < BitBoard::rowWords - 1)
+						grown |= current[w + 1] << 63;
+					if (up)
+						grown |= up[w];
+					if (down)
+						grown |= down[w];
+
+					out[w] = grown & open[w] & ~seen[w];
+					seen[w] |= out[w];
+					rowAny |= out[w];
+					reachedCount += bitCount(out[w]);
+					for (auto bits = out[w]; bits; bits &= bits - 1)
+						distanceAt(w * 64 + lowestBit(bits), y) = distance;
+				}
+				if (rowAny)
+					newTop = min(newTop, y), newBottom = max(newBottom, y);
+			}
+
+			// The old frontier only holds bits inside the band, clearing it there leaves next empty once the boards swap roles
+			for (auto y = max(0, top - 1); y <= min(height - 1, bottom + 1); y++)
+				fill(frontier.row(y), frontier.row(y) + BitBoard::rowWords, 0);
+			if (newBottom < 0)
+				return -1;
+			swap(frontier, next);
+			if (inBounds(target, height) && visited.get(target.x, target.y))
+				return distance;
+			if (distance >= maxDistance)
+				return -1;
+			top = newTop, bottom = newBottom;
+		}
+	}
+
+	vector<TilePosition> BitSearch::walkTo(TilePosition from, const int distance) const
+	{
+		vector<TilePosition> path;
+		for (auto left = distance - 1; left >= 0; left--) {
+			auto stepped = false;
+			for (auto& d : directions) {
+				const auto step = from + d;
+				if (inBounds(step, height) && visited.get(step.x, step.y) && distanceAt(step.x, step.y) == left) {
+					from = step, stepped = true;
+					break;
+				}
+			}
+			if (!stepped)
+				return {};
+			path.push_back(from);
+		}
+		return path;
+	}
+
+	vector<TilePosition> shortestPath(const BitBoard& passable, const int height, const TilePosition source, const TilePosition target, BitSearch& forward, BitSearch& back)
+	{
+		const auto distance = forward.search(passable, height, source, target);
+		if (distance <= 0)
+			return distance < 0 ? vector<TilePosition>() : vector<TilePosition>{ target };
+
+		back.search(passable, height, target, TilePositions::Invalid, distance - 1);
+		auto path = back.walkTo(source, distance);
+		reverse(path.begin(), path.end());
+		if (distance == 1)
+			path.push_back(source);
+		return path;
+	}
+}
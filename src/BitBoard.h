@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <BWAPI.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Index of the lowest set bit of a word that isn't 0, and the number of set bits
+	inline int lowestBit(const uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return int(index);
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+
+	inline int bitCount(const uint64_t word)
+	{
+#ifdef _MSC_VER
+		return int(__popcnt64(word));
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	// One bit per tile for maps of up to 256x256, every row fits in four words so a whole row moves with a few shifts
+	class BitBoard
+	{
+	public:
+		static const int maxSize = 256;
+		static const int rowWords = maxSize / 64;
+
+	private:
+		vector<uint64_t> words = vector<uint64_t>(size_t(maxSize) * rowWords);
+
+	public:
+		uint64_t * row(const int y) { return &words[size_t(y) * rowWords]; }
+		const uint64_t * row(const int y) const { return &words[size_t(y) * rowWords]; }
+
+		bool get(const int x, const int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+		void set(const int x, const int y) { row(y)[x >> 6] |= uint64_t(1) << (x & 63); }
+		void reset(const int x, const int y) { row(y)[x >> 6] &= ~(uint64_t(1) << (x & 63)); }
+		void clear() { fill(words.begin(), words.end(), 0); }
+	};
+
+	// Breadth first search that grows the whole frontier at once with shifts and masks, tiles connect through their 4 neighbors
+	// Every tile a layer reaches gets its distance written down, so a shortest path can be walked through decreasing distances
+	class BitSearch
+	{
+		BitBoard frontier, next, visited;
+		vector<uint16_t> distances = vector<uint16_t>(size_t(BitBoard::maxSize) * BitBoard::maxSize);
+		uint64_t reachedCount = 0;
+		int height = 0;
+
+		uint16_t& distanceAt(const int x, const int y) { return distances[size_t(y) * BitBoard::maxSize + x]; }
+		uint16_t distanceAt(const int x, const int y) const { return distances[size_t(y) * BitBoard::maxSize + x]; }
+
+	public:
+		// Searches from source until target is reached, nothing new can be reached or every tile up to maxDistance away is reached, returns the distance to target or -1
+		int search(const BitBoard& passable, int height, TilePosition source, TilePosition target = TilePositions::Invalid, int maxDistance = UINT16_MAX);
+
+		// How many tiles the last search reached, the source included
+		uint64_t getReachedCount() const { return reachedCount; }
+		bool reached(TilePosition here) const { return visited.get(here.x, here.y); }
+
+		// Walks from a tile the given number of steps away to the source of the last search, which has to have reached every tile up to one step less away
+		// Every step takes the first of down, right, left and up that gets one closer, so of all shortest paths it's the one a queue BFS trying them in that order finds
+		// Returns the tiles after from, ending with the source
+		vector<TilePosition> walkTo(TilePosition from, int distance) const;
+	};
+
+	// The shortest path from source to target that findPath finds, listed the way it lists it: from the target, leaving the source out unless the target is right next to it
+	// Searches forward for the distance and back from the target for the tiles on shortest paths, the caller keeps both searches so their boards are reused
+	vector<TilePosition> shortestPath(const BitBoard& passable, int height, TilePosition source, TilePosition target, BitSearch& forward, BitSearch& back);
+}
@@ -1,10 +1,20 @@
 #include "Block.h"
+#include "Trace.h"
 
 namespace BWEB
 {
+	namespace
+	{
+		// Size a building needs inside a Block, including room for an addon
+		TilePosition pieceSize(UnitType type)
+		{
+			return TilePosition(type.tileWidth() + (type.canBuildAddon() ? 2 : 0), type.tileHeight());
+		}
+	}
+
 	void Map::findStartBlock()
 	{
-		findStartBlock(Broodwar->self());
+		findStartBlock(selfRace());
 	}
 	void Map::findStartBlock(BWAPI::Player player)
 	{
@@ -43,7 +53,7 @@ namespace BWEB
 
 	void Map::findHiddenTechBlock()
 	{
-		findHiddenTechBlock(Broodwar->self());
+		findHiddenTechBlock(selfRace());
 	}
 	void Map::findHiddenTechBlock(BWAPI::Player player)
 	{
@@ -73,7 +83,7 @@ namespace BWEB
 
 	void Map::findBlocks()
 	{
-		findBlocks(Broodwar->self());
+		findBlocks(selfRace());
 	}
 	void Map::findBlocks(BWAPI::Player player)
 	{
@@ -81,46 +91,136 @@ namespace BWEB
 	}
 	void Map::findBlocks(BWAPI::Race race)
 	{
-		findStartBlock(race);
-		vector<int> heights;
-		vector<int> widths;
-		multimap<double, TilePosition> tilesByPathDist;
+		BWEB_TRACE_ZONE("findBlocks", frame());
+		ScopedTimer timer(stats, Timer::FindBlocks);
+		// The start Block is only placed by whichever of findBlocks and findBlocksLazy runs first
+		if (blockRace == Races::None)
+			findStartBlock(race);
+		blockRace = race;
+
+		// Areas that already got their Blocks lazily keep them, only the rest of the map is filled in
+		if (areasWithBlocks.empty())
+			generateBlocks(race, TilePosition(0, 0), TilePosition(game->mapWidth() - 1, game->mapHeight() - 1));
+		else {
+			for (auto& area : mapBWEM.Areas()) {
+				if (areasWithBlocks.find(&area) == areasWithBlocks.end())
+					generateBlocks(race, area.TopLeft(), area.BottomRight(), &area);
+			}
+		}
+		for (auto& area : mapBWEM.Areas())
+			areasWithBlocks.insert(&area);
+		lazyBlocks = false;
+		publish();
+	}
+
+	void Map::findBlocksLazy()
+	{
+		findBlocksLazy(selfRace());
+	}
+	void Map::findBlocksLazy(BWAPI::Player player)
+	{
+		findBlocksLazy(player->getRace());
+	}
+	void Map::findBlocksLazy(BWAPI::Race race)
+	{
+		ScopedTimer timer(stats, Timer::FindBlocks);
+		if (blockRace == Races::None)
+			findStartBlock(race);
+		blockRace = race;
+		lazyBlocks = true;
+		findBlocks(mainArea);
+		publish();
+	}
+
+	void Map::findBlocks(const BWEM::Area * area)
+	{
+		if (deferWhileBusy([this, area]() { findBlocks(area); }))
+			return;
+		if (!area || blockRace == Races::None || !areasWithBlocks.insert(area).second)
+			return;
+		generateBlocks(blockRace, area->TopLeft(), area->BottomRight(), area);
+		publish();
+	}
 
-		for (int x = 0; x < Broodwar->mapWidth(); x++) {
-			for (int y = 0; y < Broodwar->mapHeight(); y++) {
+	void Map::generateBlocks(BWAPI::Race race, const TilePosition topLeft, const TilePosition bottomRight, const BWEM::Area * area)
+	{
+		auto pass = beginBlocks(race, topLeft, bottomRight, area);
+		while (!stepBlocks(pass, SIZE_MAX)) {}
+	}
+
+	Map::BlockPass Map::beginBlocks(BWAPI::Race race, const TilePosition topLeft, const TilePosition bottomRight, const BWEM::Area * area)
+	{
+		BlockPass pass;
+		pass.race = race;
+		pass.topLeft = topLeft;
+
+		// Blocks anchored up to 20 tiles above or left of the region can still cover it
+		vector<pair<double, TilePosition>> tilesByPathDist;
+		for (int x = max(0, topLeft.x - 19); x <= min(game->mapWidth() - 1, bottomRight.x); x++) {
+			for (int y = max(0, topLeft.y - 19); y <= min(game->mapHeight() - 1, bottomRight.y); y++) {
 				TilePosition t(x, y);
 				Position p(t);
-				if (t.isValid() && Broodwar->isBuildable(t)) {
-					double dist = naturalChoke ? p.getDistance(Position(naturalChoke->Center())) : p.getDistance(mainPosition);						
-					tilesByPathDist.insert(make_pair(dist, t));
+				if (t.isValid() && game->isBuildable(t) && (!area || mapBWEM.GetArea(t) == area)) {
+					double dist = naturalChoke ? p.getDistance(Position(naturalChoke->Center())) : p.getDistance(mainPosition);
+					tilesByPathDist.emplace_back(dist, t);
 				}
 			}
 		}
+		stable_sort(tilesByPathDist.begin(), tilesByPathDist.end(), [](auto& l, auto& r) { return l.first < r.first; });
+		for (auto& t : tilesByPathDist)
+			pass.tiles.push_back(t.second);
 
 		if (race == Races::Protoss) {
-			heights.insert(heights.end(), { 2, 4, 5, 6, 8 });
-			widths.insert(widths.end(), { 2, 4, 5, 8, 10, 18 });
+			pass.heights.insert(pass.heights.end(), { 2, 4, 5, 6, 8 });
+			pass.widths.insert(pass.widths.end(), { 2, 4, 5, 8, 10, 18 });
 		}
 		else if (race == Races::Terran) {
-			heights.insert(heights.end(), { 2, 4, 5, 6 });
-			widths.insert(widths.end(), { 3, 6, 10 });
+			pass.heights.insert(pass.heights.end(), { 2, 4, 5, 6 });
+			pass.widths.insert(pass.widths.end(), { 3, 6, 10 });
 		}
+		return pass;
+	}
+
+	bool Map::stepBlocks(BlockPass& pass, const size_t tiles)
+	{
+		// Iterate every size from largest to smallest and every tile from closest to furthest, picking up where the last step stopped
+		size_t tested = 0;
+		for (; pass.width > 0; pass.width--, pass.height = 20) {
+			if (find(pass.widths.begin(), pass.widths.end(), pass.width) == pass.widths.end())
+				continue;
+			BWEB_TRACE_ZONE("findBlocks size pass", frame());
+
+			for (; pass.height > 0; pass.height--, pass.next = 0) {
+				if (find(pass.heights.begin(), pass.heights.end(), pass.height) == pass.heights.end())
+					continue;
 
-		// Iterate every tile
-		for (int i = 20; i > 0; i--) {
-			for (int j = 20; j > 0; j--) {
-				for (auto& t : tilesByPathDist) {
+				for (; pass.next < pass.tiles.size(); pass.next++) {
+					if (tested == tiles)
+						return false;
 
-					TilePosition tile(t.second);
-					if (find(heights.begin(), heights.end(), j) == heights.end() || find(widths.begin(), widths.end(), i) == widths.end())
+					const auto tile = pass.tiles[pass.next];
+					if (tile.x + pass.width <= pass.topLeft.x || tile.y + pass.height <= pass.topLeft.y)
 						continue;
 
-					if (canAddBlock(tile, i, j)) {
-						insertBlock(race, tile, i, j);
-					}
+					tested++;
+					if (canAddBlock(tile, pass.width, pass.height))
+						insertBlock(pass.race, tile, pass.width, pass.height);
 				}
 			}
 		}
+		return true;
+	}
+
+	void Map::regenerateBlocks()
+	{
+		// Regions are queued as blocks are erased or buildings outside of blocks die, and only refilled once placements are asked for again
+		auto regions = move(dirtyRegions);
+		dirtyRegions.clear();
+		for (auto& region : regions) {
+			if (lazyBlocks && areasWithBlocks.find(mapBWEM.GetNearestArea(region.first)) == areasWithBlocks.end())
+				continue;
+			generateBlocks(blockRace, region.first, region.second);
+		}
 	}
 
 	bool Map::canAddBlock(const TilePosition here, const int width, const int height)
@@ -142,10 +242,14 @@ namespace BWEB
 			for (auto y = here.y - 1; y < here.y + height + 1; y++) {
 
 				TilePosition t(x, y);
-				if (!t.isValid() || !mapBWEM.GetTile(t).Buildable() || overlapGrid[x][y] > 0 || overlapsMining(t))
+				if (!t.isValid() || !mapBWEM.GetTile(t).Buildable() || overlapGrid[x][y] > 0 || overlapsMining(t) || usedTiles.find(t) != usedTiles.end())
 					return false;
 			}
 		}
+
+		// Blocks keep a free border, but a row of them can still close off a narrow area
+		if (keepConnected && !keepsConnected(here, width, height))
+			return false;
 		return true;
 	}
 
@@ -283,13 +387,153 @@ namespace BWEB
 			}
 			else return;
 		}
-		blocks.push_back(newBlock);
-		addOverlap(here, width, height);
+		storeBlock(newBlock);
+	}
+
+	const Block* Map::createBlock(const vector<UnitType>& types, const BWEM::Area * area, const TilePosition here)
+	{
+		if (busy(Subsystem::Blocks) || !area || types.empty())
+			return nullptr;
+
+		auto totalSize = 0, minWidth = 0, minHeight = 0, sumWidth = 0, sumHeight = 0;
+		for (auto& type : types) {
+			if (!type.isBuilding() || type.isAddon())
+				return nullptr;
+			const auto size = pieceSize(type);
+			totalSize += size.x * size.y;
+			minWidth = max(minWidth, size.x), minHeight = max(minHeight, size.y);
+			sumWidth += size.x, sumHeight += size.y;
+		}
+
+		// Every Block size that could hold the pieces without wasting more space than they use, most compact first
+		vector<TilePosition> dimensions;
+		for (auto w = minWidth; w <= min(sumWidth, 20); w++) {
+			for (auto h = minHeight; h <= min(sumHeight, 20); h++) {
+				if (w * h >= totalSize && w * h <= totalSize * 2)
+					dimensions.emplace_back(w, h);
+			}
+		}
+		sort(dimensions.begin(), dimensions.end(), [](const TilePosition& l, const TilePosition& r) {
+			return make_pair(l.x * l.y, l.x + l.y) < make_pair(r.x * r.y, r.x + r.y);
+		});
+
+		const auto center = here.isValid() ? here : TilePosition(area->Top());
+		vector<pair<TilePosition, UnitType>> placements;
+		for (auto& dimension : dimensions) {
+			const auto w = dimension.x, h = dimension.y;
+			if (!packBlock(types, w, h, placements))
+				continue;
+
+			// Find the closest spot inside the area where the Block fits
+			auto distBest = DBL_MAX;
+			auto tileBest = TilePositions::Invalid;
+			for (auto x = center.x - w - 12; x <= center.x + 12; x++) {
+				for (auto y = center.y - h - 12; y <= center.y + 12; y++) {
+					const TilePosition t(x, y);
+					const auto blockCenter = Position(t) + Position(w * 16, h * 16);
+					const auto dist = blockCenter.getDistance(Position(center) + Position(16, 16));
+					if (!t.isValid() || dist >= distBest)
+						continue;
+					if (tilesWithinArea(area, t, w, h) == w * h && canAddBlock(t, w, h))
+						distBest = dist, tileBest = t;
+				}
+			}
+			if (!tileBest.isValid())
+				continue;
+
+			Block newBlock(w, h, tileBest);
+			for (auto& placement : placements) {
+				const auto tile = tileBest + placement.first;
+				const auto footprint = footprintOf(placement.second);
+				if (footprint == Footprint::Large)
+					newBlock.insertLarge(tile);
+				else if (footprint == Footprint::Medium)
+					newBlock.insertMedium(tile);
+				else
+					newBlock.insertSmall(tile);
+			}
+			storeBlock(newBlock);
+			publish();
+			return &blocks.back();
+		}
+		return nullptr;
+	}
+
+	bool Map::packBlock(const vector<UnitType>& types, const int width, const int height, vector<pair<TilePosition, UnitType>>& placements)
+	{
+		// Group identical pieces so each UnitType is only tried once per cell, largest first
+		map<UnitType, int> counts;
+		auto slack = width * height;
+		for (auto& type : types) {
+			counts[type]++;
+			slack -= pieceSize(type).x * pieceSize(type).y;
+		}
+		vector<pair<UnitType, int>> pieces(counts.begin(), counts.end());
+		sort(pieces.begin(), pieces.end(), [](const pair<UnitType, int>& l, const pair<UnitType, int>& r) {
+			return pieceSize(l.first).x * pieceSize(l.first).y > pieceSize(r.first).x * pieceSize(r.first).y;
+		});
+
+		auto remaining = int(types.size());
+		auto nodes = 0;
+		vector<int> grid(width * height, 0);
+		placements.clear();
+
+		const auto fits = [&](const TilePosition size, const int x, const int y) {
+			if (x + size.x > width || y + size.y > height)
+				return false;
+			for (auto dx = 0; dx < size.x; dx++) {
+				for (auto dy = 0; dy < size.y; dy++) {
+					if (grid[(y + dy) * width + x + dx] != 0)
+						return false;
+				}
+			}
+			return true;
+		};
+
+		const auto fill = [&](const TilePosition size, const int x, const int y, const int value) {
+			for (auto dx = 0; dx < size.x; dx++) {
+				for (auto dy = 0; dy < size.y; dy++)
+					grid[(y + dy) * width + x + dx] = value;
+			}
+		};
+
+		// Branch and bound over the first empty cell: either a piece starts here or the cell is left empty, as long as we can afford to waste it
+		function<bool(int)> pack = [&](int cell) {
+			while (cell < width * height && grid[cell] != 0)
+				cell++;
+			if (remaining == 0)
+				return true;
+			if (cell == width * height || ++nodes > 50000)
+				return false;
+
+			const auto x = cell % width, y = cell / width;
+			for (auto& piece : pieces) {
+				const auto size = pieceSize(piece.first);
+				if (piece.second == 0 || !fits(size, x, y))
+					continue;
+
+				fill(size, x, y, 1), piece.second--, remaining--;
+				placements.emplace_back(TilePosition(x, y), piece.first);
+				if (pack(cell + 1))
+					return true;
+				fill(size, x, y, 0), piece.second++, remaining++;
+				placements.pop_back();
+			}
+
+			if (slack > 0) {
+				grid[cell] = 2, slack--;
+				if (pack(cell + 1))
+					return true;
+				grid[cell] = 0, slack++;
+			}
+			return false;
+		};
+		return pack(0);
 	}
 
 	void Map::insertStartBlock(const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
 	{
-		insertStartBlock(Broodwar->self(), here, mirrorHorizontal, mirrorVertical);
+		insertStartBlock(selfRace(), here, mirrorHorizontal, mirrorVertical);
 	}
 
 	void Map::insertStartBlock(BWAPI::Player player, const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
@@ -307,24 +551,22 @@ namespace BWEB
 				if (mirrorVertical)
 				{
 					Block newBlock(8, 5, here);
-					addOverlap(here, 8, 5);
 					newBlock.insertLarge(here);
 					newBlock.insertLarge(here + TilePosition(4, 0));
 					newBlock.insertSmall(here + TilePosition(6, 3));
 					newBlock.insertMedium(here + TilePosition(0, 3));
 					newBlock.insertMedium(here + TilePosition(3, 3));
-					blocks.push_back(newBlock);
+					storeBlock(newBlock);
 				}
 				else
 				{
 					Block newBlock(8, 5, here);
-					addOverlap(here, 8, 5);
 					newBlock.insertLarge(here + TilePosition(0, 2));
 					newBlock.insertLarge(here + TilePosition(4, 2));
 					newBlock.insertSmall(here + TilePosition(6, 0));
 					newBlock.insertMedium(here + TilePosition(0, 0));
 					newBlock.insertMedium(here + TilePosition(3, 0));
-					blocks.push_back(newBlock);
+					storeBlock(newBlock);
 				}
 			}
 			else
@@ -332,42 +574,39 @@ namespace BWEB
 				if (mirrorVertical)
 				{
 					Block newBlock(8, 5, here);
-					addOverlap(here, 8, 5);
 					newBlock.insertLarge(here);
 					newBlock.insertLarge(here + TilePosition(4, 0));
 					newBlock.insertSmall(here + TilePosition(0, 3));
 					newBlock.insertMedium(here + TilePosition(2, 3));
 					newBlock.insertMedium(here + TilePosition(5, 3));
-					blocks.push_back(newBlock);
+					storeBlock(newBlock);
 				}
 				else
 				{
 					Block newBlock(8, 5, here);
-					addOverlap(here, 8, 5);
 					newBlock.insertLarge(here + TilePosition(0, 2));
 					newBlock.insertLarge(here + TilePosition(4, 2));
 					newBlock.insertSmall(here + TilePosition(0, 0));
 					newBlock.insertMedium(here + TilePosition(2, 0));
 					newBlock.insertMedium(here + TilePosition(5, 0));
-					blocks.push_back(newBlock);
+					storeBlock(newBlock);
 				}
 			}
 		}
 		else if (race == Races::Terran)
 		{
 			Block newBlock(6, 5, here);
-			addOverlap(here, 6, 5);
 			newBlock.insertLarge(here);
 			newBlock.insertSmall(here + TilePosition(4, 1));
 			newBlock.insertMedium(here + TilePosition(0, 3));
 			newBlock.insertMedium(here + TilePosition(3, 3));
-			blocks.push_back(newBlock);
+			storeBlock(newBlock);
 		}
 	}
 
 	void Map::insertTechBlock(TilePosition here, bool mirrorHorizontal, bool mirrorVertical)
 	{
-		insertTechBlock(Broodwar->self(), here, mirrorHorizontal, mirrorVertical);
+		insertTechBlock(selfRace(), here, mirrorHorizontal, mirrorVertical);
 	}
 	void Map::insertTechBlock(BWAPI::Player player, TilePosition here, bool mirrorHorizontal, bool mirrorVertical)
 	{
@@ -378,31 +617,66 @@ namespace BWEB
 		if (race == Races::Protoss)
 		{
 			Block newBlock(5, 4, here);
-			addOverlap(here, 5, 4);
 			newBlock.insertSmall(here);
 			newBlock.insertSmall(here + TilePosition(0, 2));
 			newBlock.insertMedium(here + TilePosition(2, 0));
 			newBlock.insertMedium(here + TilePosition(2, 2));
-			blocks.push_back(newBlock);
+			storeBlock(newBlock);
 		}
 	}
 
 	void Map::eraseBlock(const TilePosition here)
 	{
+		if (deferWhileBusy([this, here]() { eraseBlock(here); }))
+			return;
 		for (auto it = blocks.begin(); it != blocks.end(); ++it)
 		{
-			auto&  block = *it;
-			if (here.x >= block.Location().x && here.x < block.Location().x + block.width() && here.y >= block.Location().y && here.y < block.Location().y + block.height())
+			if (here.x >= it->Location().x && here.x < it->Location().x + it->width() && here.y >= it->Location().y && here.y < it->Location().y + it->height())
 			{
+				// Removed first so the owner search below can't find it again
+				const auto block = *it;
 				blocks.erase(it);
-				// Remove overlap
+				eraseSlots(block);
+
+				// Only the Block layer goes, anything else on these tiles keeps its overlap and becomes the owner if the Block was
+				blocksChanged = overlapChanged = true;
+				const auto tile = block.Location();
+				for (auto x = tile.x; x < tile.x + block.width(); x++) {
+					for (auto y = tile.y; y < tile.y + block.height(); y++)
+						removeOverlap(x, y, OwnerType::Block);
+				}
+				occupancyChanged(tile, block.width(), block.height());
+
+				// Refill the space the next time a placement is asked for
+				if (blockRace != Races::None)
+					dirtyRegions.emplace_back(tile, tile + TilePosition(block.width() - 1, block.height() - 1));
+
+				publish();
 				return;
 			}
 		}
 	}
 
+	void Map::storeBlock(Block& block)
+	{
+		blocksChanged = true;
+		block.setId(nextId++);
+		addOverlap(block.Location(), block.width(), block.height(), Owner{ OwnerType::Block, block.Id() });
+		insertSlots(block);
+		blocks.push_back(block);
+	}
+
+	const Block* Map::getBlockById(const int id) const
+	{
+		if (busy(Subsystem::Blocks))
+			return nullptr;
+		return findById(blocks, id, [](const Block& block) { return block.Id(); });
+	}
+
 	const Block* Map::getClosestBlock(TilePosition here) const
 	{
+		if (busy(Subsystem::Blocks))
+			return nullptr;
 		double distBest = DBL_MAX;
 		const Block* bestBlock = nullptr;
 		for (auto& block : blocks)
@@ -10,7 +10,7 @@ namespace BWEB
 	{
 		int w, h;
 		TilePosition t;
-		set <TilePosition> small, medium, large;
+		SlotBuffer slots;
 	public:
 		Block() : w(0), h(0) {};
 		Block(int, int, TilePosition);
@@ -20,17 +20,24 @@ namespace BWEB
 		// Returns the top left tile position of this block
 		TilePosition Location() const { return t; }
 
-		// Returns the const set of tilepositions that belong to 2x2 (small) buildings
-		set<TilePosition> SmallTiles() const { return small; }
+		// Returns the id of this block
+		int Id() const { return slots.getOwner(); }
+		void setId(const int id) { slots.setOwner(id); }
 
-		// Returns the const set of tilepositions that belong to 3x2 (medium) buildings
-		set<TilePosition> MediumTiles() const { return medium; }
+		// Returns every slot of this block, grouped by footprint
+		const SlotBuffer& Slots() const { return slots; }
 
-		// Returns the const set of tilepositions that belong to 4x3 (large) buildings
-		set<TilePosition> LargeTiles() const { return large; }
+		// Returns the tilepositions that belong to 2x2 (small) buildings
+		TileRange SmallTiles() const { return slots.of(Footprint::Small); }
 
-		void insertSmall(const TilePosition here) { small.insert(here); }
-		void insertMedium(const TilePosition here) { medium.insert(here); }
-		void insertLarge(const TilePosition here) { large.insert(here); }
+		// Returns the tilepositions that belong to 3x2 (medium) buildings
+		TileRange MediumTiles() const { return slots.of(Footprint::Medium); }
+
+		// Returns the tilepositions that belong to 4x3 (large) buildings
+		TileRange LargeTiles() const { return slots.of(Footprint::Large); }
+
+		void insertSmall(const TilePosition here) { slots.insert(here, Footprint::Small); }
+		void insertMedium(const TilePosition here) { slots.insert(here, Footprint::Medium); }
+		void insertLarge(const TilePosition here) { slots.insert(here, Footprint::Large); }
 	};
 }
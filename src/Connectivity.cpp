@@ -0,0 +1,208 @@
+#include "Connectivity.h"
+
+namespace BWEB
+{
+	namespace
+	{
+		const TilePosition directions[4] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+		bool inside(const TilePosition t, const TilePosition here, const int width, const int height)
+		{
+			return t.x >= here.x && t.y >= here.y && t.x < here.x + width && t.y < here.y + height;
+		}
+	}
+
+	uint32_t Connectivity::nextStamp()
+	{
+		// Stamps let every search reuse one grid without clearing it
+		if (++stamp == 0) {
+			seen.resize(seen.width(), seen.height());
+			stamp = 1;
+		}
+		return stamp;
+	}
+
+	void Connectivity::flood(const TilePosition from, const int label)
+	{
+		// Takes over every open tile reachable from here that doesn't have this label yet
+		queue.clear();
+		queue.push_back(from);
+		labels[from.x][from.y] = label;
+		for (size_t i = 0; i < queue.size(); i++) {
+			const auto tile = queue[i];
+			for (auto& d : directions) {
+				const auto next = tile + d;
+				if (!labels.contains(next.x, next.y))
+					continue;
+				auto& nextLabel = labels[next.x][next.y];
+				if (nextLabel == 0 || nextLabel == label)
+					continue;
+				nextLabel = label;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	void Connectivity::ringOf(const TilePosition here, const int width, const int height)
+	{
+		// The tiles just outside the rectangle, clockwise from the top left corner so neighbors in the list are neighbors on the map
+		ring.clear();
+		for (auto x = here.x - 1; x <= here.x + width; x++)
+			ring.emplace_back(x, here.y - 1);
+		for (auto y = here.y; y <= here.y + height; y++)
+			ring.emplace_back(here.x + width, y);
+		for (auto x = here.x + width - 1; x >= here.x - 1; x--)
+			ring.emplace_back(x, here.y + height);
+		for (auto y = here.y + height - 1; y >= here.y; y--)
+			ring.emplace_back(here.x - 1, y);
+	}
+
+	int Connectivity::openRuns() const
+	{
+		// Counts the stretches of open tiles around the ring, one stretch can always walk around the rectangle
+		auto runs = 0;
+		auto open = 0;
+		for (size_t i = 0; i < ring.size(); i++) {
+			const auto current = label(ring[i]) > 0;
+			const auto previous = label(ring[(i + ring.size() - 1) % ring.size()]) > 0;
+			open += current;
+			runs += current && !previous;
+		}
+		return open == int(ring.size()) ? 1 : runs;
+	}
+
+	void Connectivity::build(const int width, const int height, const function<bool(TilePosition)>& open)
+	{
+		labels.resize(width, height);
+		seen.resize(width, height);
+		stamp = 0;
+		nextLabel = 1;
+
+		for (auto x = 0; x < width; x++) {
+			for (auto y = 0; y < height; y++)
+				labels[x][y] = open(TilePosition(x, y)) ? -1 : 0;
+		}
+		for (auto x = 0; x < width; x++) {
+			for (auto y = 0; y < height; y++) {
+				if (labels[x][y] < 0)
+					flood(TilePosition(x, y), nextLabel++);
+			}
+		}
+	}
+
+	void Connectivity::update(const TilePosition here, const int width, const int height, const function<bool(TilePosition)>& open)
+	{
+		if (!built())
+			return;
+
+		auto closed = false, opened = false, leftOpen = false;
+		for (auto x = here.x; x < here.x + width; x++) {
+			for (auto y = here.y; y < here.y + height; y++) {
+				if (!labels.contains(x, y))
+					continue;
+				const auto now = open(TilePosition(x, y));
+				auto& tile = labels[x][y];
+				if (tile != 0 && !now)
+					tile = 0, closed = true;
+				else if (tile == 0 && now)
+					tile = -1, opened = true;
+				leftOpen |= now;
+			}
+		}
+
+		// Closing tiles can only split a component if more than one open run is left around them, or open tiles are left inside
+		if (closed) {
+			ringOf(here, width, height);
+			if (leftOpen || openRuns() > 1) {
+				const auto first = nextLabel;
+				for (auto& t : ring) {
+					if (label(t) > 0 && label(t) < first)
+						flood(t, nextLabel++);
+				}
+				for (auto x = here.x; x < here.x + width; x++) {
+					for (auto y = here.y; y < here.y + height; y++) {
+						if (label(TilePosition(x, y)) > 0 && label(TilePosition(x, y)) < first)
+							flood(TilePosition(x, y), nextLabel++);
+					}
+				}
+			}
+		}
+
+		// Opened tiles join the component of a neighbor and merge every other component they touch into it
+		if (opened) {
+			for (auto x = here.x; x < here.x + width; x++) {
+				for (auto y = here.y; y < here.y + height; y++) {
+					const TilePosition t(x, y);
+					if (!labels.contains(x, y) || labels[x][y] >= 0)
+						continue;
+					auto joined = 0;
+					for (auto& d : directions) {
+						if (label(t + d) > 0) {
+							joined = label(t + d);
+							break;
+						}
+					}
+					flood(t, joined > 0 ? joined : nextLabel++);
+				}
+			}
+		}
+	}
+
+	bool Connectivity::keepsConnected(const TilePosition here, const int width, const int height, const vector<TilePosition>& keys)
+	{
+		if (!built())
+			return true;
+
+		for (auto& key : keys) {
+			if (label(key) > 0 && inside(key, here, width, height))
+				return false;
+		}
+
+		// One open run around the rectangle means anything walking through it can walk around it instead
+		ringOf(here, width, height);
+		if (openRuns() <= 1)
+			return true;
+
+		// Otherwise search from one key of every component for the other keys of it, stepping around the rectangle
+		for (size_t i = 0; i < keys.size(); i++) {
+			const auto component = label(keys[i]);
+			if (component <= 0)
+				continue;
+
+			auto wanted = 0;
+			auto firstOfComponent = true;
+			for (size_t j = 0; j < keys.size(); j++) {
+				if (label(keys[j]) != component)
+					continue;
+				if (j < i)
+					firstOfComponent = false;
+				else if (j > i && keys[j] != keys[i])
+					wanted++;
+			}
+			if (!firstOfComponent || wanted == 0)
+				continue;
+
+			const auto visit = nextStamp();
+			queue.clear();
+			queue.push_back(keys[i]);
+			seen[keys[i].x][keys[i].y] = visit;
+			for (size_t q = 0; q < queue.size() && wanted > 0; q++) {
+				const auto tile = queue[q];
+				for (auto& d : directions) {
+					const auto next = tile + d;
+					if (label(next) != component || inside(next, here, width, height) || seen[next.x][next.y] == visit)
+						continue;
+					seen[next.x][next.y] = visit;
+					queue.push_back(next);
+					for (size_t j = i + 1; j < keys.size(); j++) {
+						if (keys[j] == next && keys[j] != keys[i])
+							wanted--;
+					}
+				}
+			}
+			if (wanted > 0)
+				return false;
+		}
+		return true;
+	}
+}
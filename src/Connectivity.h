@@ -0,0 +1,43 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <BWAPI.h>
+#include "Grid.h"
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Labels every open tile with the component it belongs to, tiles connect through their 4 neighbors
+	// Closing or opening a few tiles only relabels what they can change, closing a rectangle that leaves one open run around it relabels nothing
+	class Connectivity
+	{
+		Grid<int> labels;
+		Grid<uint32_t> seen;
+		uint32_t stamp = 0;
+		int nextLabel = 1;
+		vector<TilePosition> queue, ring;
+
+		void flood(TilePosition from, int label);
+		void ringOf(TilePosition here, int width, int height);
+		int openRuns() const;
+		uint32_t nextStamp();
+
+	public:
+		bool built() const { return labels.width() > 0; }
+
+		// Labels the whole map, open decides which tiles units can walk through
+		void build(int width, int height, const function<bool(TilePosition)>& open);
+
+		// Reads the tiles of a rectangle again after they changed and repairs the labels around them
+		void update(TilePosition here, int width, int height, const function<bool(TilePosition)>& open);
+
+		// Returns the component of a tile, 0 if it is closed
+		int label(TilePosition here) const { return labels.contains(here.x, here.y) ? labels[here.x][here.y] : 0; }
+		bool connected(TilePosition a, TilePosition b) const { return label(a) > 0 && label(a) == label(b); }
+
+		// Returns true if closing the rectangle leaves every pair of keys that is connected now still connected
+		bool keepsConnected(TilePosition here, int width, int height, const vector<TilePosition>& keys);
+	};
+}
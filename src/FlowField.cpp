@@ -0,0 +1,184 @@
+#include "FlowField.h"
+#include <queue>
+
+namespace BWEB
+{
+	namespace
+	{
+		// Straight directions first and every direction next to its opposite, a tile stores the index of the direction it steps in plus one, 0 is unreachable
+		const TilePosition directions[8] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 } };
+		const uint8_t atGoal = 0xFF;
+
+		uint32_t stepCost(const int direction) { return direction < 4 ? 10 : 14; }
+	}
+
+	bool FlowField::canStep(const TilePosition from, const int direction) const
+	{
+		const auto to = from + directions[direction];
+		if (!costs.contains(to.x, to.y) || closed[to.x][to.y])
+			return false;
+		if (direction < 4)
+			return true;
+		return !closed[to.x][from.y] && !closed[from.x][to.y];
+	}
+
+	bool FlowField::dependsOn(const TilePosition tile, const TilePosition changed) const
+	{
+		// A tile depends on the tile it steps to and, for a diagonal step, on both corners it passes
+		const auto step = steps[tile.x][tile.y];
+		if (step == 0 || step == atGoal)
+			return false;
+		const auto to = tile + directions[step - 1];
+		return to == changed || (step > 4 && (TilePosition(to.x, tile.y) == changed || TilePosition(tile.x, to.y) == changed));
+	}
+
+	void FlowField::build(const int width, const int height, const vector<TilePosition>& goals, const function<bool(TilePosition)>& open)
+	{
+		goalTiles = goals;
+		costs.resize(width, height);
+		steps.resize(width, height);
+		closed.resize(width, height);
+		goal.resize(width, height);
+		pending.clear();
+
+		for (auto x = 0; x < width; x++) {
+			for (auto y = 0; y < height; y++) {
+				costs[x][y] = unreachable;
+				closed[x][y] = !open(TilePosition(x, y));
+			}
+		}
+
+		// Goals are reached even when something is placed on them, a defense tile is still where units should stand
+		vector<TilePosition> seeds;
+		for (auto& tile : goalTiles) {
+			if (!costs.contains(tile.x, tile.y))
+				continue;
+			goal[tile.x][tile.y] = true;
+			closed[tile.x][tile.y] = false;
+			costs[tile.x][tile.y] = 0;
+			steps[tile.x][tile.y] = atGoal;
+			seeds.push_back(tile);
+		}
+		relax(seeds);
+	}
+
+	void FlowField::relax(vector<TilePosition>& seeds)
+	{
+		// Dijkstra from every seed with the cost it already has, a tile only ever gets cheaper
+		using Entry = pair<uint32_t, TilePosition>;
+		const auto cheaper = [](const Entry& l, const Entry& r) { return l.first > r.first; };
+		priority_queue<Entry, vector<Entry>, decltype(cheaper)> open(cheaper);
+		for (auto& seed : seeds) {
+			if (costs[seed.x][seed.y] != unreachable)
+				open.emplace(costs[seed.x][seed.y], seed);
+		}
+
+		while (!open.empty()) {
+			const auto current = open.top();
+			open.pop();
+			const auto tile = current.second;
+			if (current.first != costs[tile.x][tile.y])
+				continue;
+
+			for (int i = 0; i < 8; i++) {
+				if (!canStep(tile, i))
+					continue;
+				const auto next = tile + directions[i];
+				const auto cost = current.first + stepCost(i);
+				if (goal[next.x][next.y] || cost >= costs[next.x][next.y])
+					continue;
+
+				// The neighbor steps back the way we came, the opposite direction sits next to it in the table
+				costs[next.x][next.y] = cost;
+				steps[next.x][next.y] = uint8_t((i ^ 1) + 1);
+				open.emplace(cost, next);
+			}
+		}
+	}
+
+	void FlowField::repair(const function<bool(TilePosition)>& open)
+	{
+		if (pending.empty())
+			return;
+
+		// Read the changed tiles again, tiles that closed lose their cost along with every tile that stepped through them
+		vector<TilePosition> lost, seeds;
+		for (auto& region : pending) {
+			for (auto x = max(0, region.first.x); x <= min(costs.width() - 1, region.second.x); x++) {
+				for (auto y = max(0, region.first.y); y <= min(costs.height() - 1, region.second.y); y++) {
+					const TilePosition t(x, y);
+					if (goal[x][y])
+						continue;
+
+					const auto isOpen = open(t);
+					if (isOpen == !closed[x][y])
+						continue;
+					closed[x][y] = !isOpen;
+
+					if (!isOpen) {
+						for (auto& d : directions) {
+							const auto neighbor = t + d;
+							if (costs.contains(neighbor.x, neighbor.y) && costs[neighbor.x][neighbor.y] != unreachable && dependsOn(neighbor, t))
+								lost.push_back(neighbor);
+						}
+						if (costs[x][y] != unreachable)
+							lost.push_back(t);
+					}
+					else {
+						for (auto& d : directions) {
+							const auto neighbor = t + d;
+							if (costs.contains(neighbor.x, neighbor.y) && costs[neighbor.x][neighbor.y] != unreachable)
+								seeds.push_back(neighbor);
+						}
+					}
+				}
+			}
+		}
+		pending.clear();
+
+		for (size_t i = 0; i < lost.size(); i++) {
+			const auto tile = lost[i];
+			if (costs[tile.x][tile.y] == unreachable)
+				continue;
+			costs[tile.x][tile.y] = unreachable;
+			for (auto& d : directions) {
+				const auto neighbor = tile + d;
+				if (costs.contains(neighbor.x, neighbor.y) && costs[neighbor.x][neighbor.y] != unreachable && dependsOn(neighbor, tile))
+					lost.push_back(neighbor);
+			}
+		}
+
+		// Everything that lost its cost is filled in again from the tiles around it that kept theirs
+		for (auto& tile : lost) {
+			steps[tile.x][tile.y] = 0;
+			for (auto& d : directions) {
+				const auto neighbor = tile + d;
+				if (costs.contains(neighbor.x, neighbor.y) && costs[neighbor.x][neighbor.y] != unreachable)
+					seeds.push_back(neighbor);
+			}
+		}
+		relax(seeds);
+	}
+
+	TilePosition FlowField::getNext(const TilePosition here) const
+	{
+		if (!costs.contains(here.x, here.y) || costs[here.x][here.y] == unreachable)
+			return TilePositions::Invalid;
+		const auto step = steps[here.x][here.y];
+		return step == atGoal ? here : here + directions[step - 1];
+	}
+
+	vector<TilePosition> FlowField::getPath(TilePosition here) const
+	{
+		vector<TilePosition> path;
+		if (getNext(here) == TilePositions::Invalid)
+			return path;
+
+		path.push_back(here);
+		while (steps[here.x][here.y] != atGoal) {
+			here = getNext(here);
+			path.push_back(here);
+		}
+		return path;
+	}
+}
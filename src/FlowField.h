@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <BWAPI.h>
+#include "Grid.h"
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Cost of walking every tile to the closest of a set of goal tiles, and the direction to step in from every tile
+	// One field serves every unit heading to the same goals, and only the tiles a change can reach are searched again when occupancy changes
+	class FlowField
+	{
+		vector<TilePosition> goalTiles;
+		Grid<uint32_t> costs;
+		Grid<uint8_t> steps;
+		BitGrid closed, goal;
+		vector<pair<TilePosition, TilePosition>> pending;
+
+		void relax(vector<TilePosition>& seeds);
+		bool canStep(TilePosition from, int direction) const;
+		bool dependsOn(TilePosition tile, TilePosition changed) const;
+
+	public:
+		static const uint32_t unreachable = UINT32_MAX;
+
+		// Straight steps cost 10 and diagonal steps 14, diagonals can't cut past a closed corner
+		void build(int width, int height, const vector<TilePosition>& goals, const function<bool(TilePosition)>& open);
+
+		// Remembers a rectangle whose tiles changed, the field is repaired the next time repair is called
+		void invalidate(TilePosition here, int width, int height) { pending.emplace_back(here, here + TilePosition(width - 1, height - 1)); }
+		bool isDirty() const { return !pending.empty(); }
+		void repair(const function<bool(TilePosition)>& open);
+
+		const vector<TilePosition>& getGoals() const { return goalTiles; }
+
+		/// <summary> Returns the cost of walking from this TilePosition to the closest goal, FlowField::unreachable if there is no way. </summary>
+		uint32_t getCost(TilePosition here) const { return costs.contains(here.x, here.y) ? costs[here.x][here.y] : unreachable; }
+
+		/// <summary> Returns the next TilePosition to walk to, the same TilePosition at a goal and TilePositions::Invalid if no goal can be reached. </summary>
+		TilePosition getNext(TilePosition here) const;
+
+		/// <summary> Returns every TilePosition from here to the closest goal by following the field. </summary>
+		vector<TilePosition> getPath(TilePosition here) const;
+	};
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace BWEB
+{
+	using namespace std;
+
+	const size_t cacheLine = 64;
+
+	// Allocator that starts every buffer on a cache line
+	template <class T>
+	struct CacheAllocator
+	{
+		using value_type = T;
+		CacheAllocator() = default;
+		template <class U> CacheAllocator(const CacheAllocator<U>&) {}
+		T * allocate(size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), align_val_t(cacheLine))); }
+		void deallocate(T * p, size_t) { ::operator delete(p, align_val_t(cacheLine)); }
+		template <class U> bool operator==(const CacheAllocator<U>&) const { return true; }
+		template <class U> bool operator!=(const CacheAllocator<U>&) const { return false; }
+	};
+
+	// Grid sized to the map, indexed as grid[x][y] and stored row by row with every row padded to whole cache lines
+	template <class T>
+	class Grid
+	{
+		static const int lineCells = sizeof(T) >= cacheLine ? 1 : int(cacheLine / sizeof(T));
+		int w = 0, h = 0, stride = 0;
+		vector<T, CacheAllocator<T>> cells;
+
+		template <class Cell>
+		struct Column
+		{
+			Cell * first;
+			int stride;
+			Cell& operator[](const int y) const { return first[y * stride]; }
+		};
+
+	public:
+		static int strideFor(const int width) { return (width + lineCells - 1) / lineCells * lineCells; }
+		static size_t bytesFor(const int width, const int height) { return size_t(strideFor(width)) * size_t(height) * sizeof(T); }
+
+		void resize(const int width, const int height)
+		{
+			w = width, h = height;
+			stride = strideFor(width);
+			cells.assign(size_t(stride) * size_t(height), T());
+		}
+
+		int width() const { return w; }
+		int height() const { return h; }
+		bool contains(const int x, const int y) const { return x >= 0 && y >= 0 && x < w && y < h; }
+
+		Column<T> operator[](const int x) { return { cells.data() + x, stride }; }
+		Column<const T> operator[](const int x) const { return { cells.data() + x, stride }; }
+
+		// Raw storage, used to save and load a grid in one copy
+		void * data() { return cells.data(); }
+		const void * data() const { return cells.data(); }
+		size_t bytes() const { return cells.size() * sizeof(T); }
+	};
+
+	// Grid of flags, one bit per tile, rows padded to whole cache lines
+	class BitGrid
+	{
+		static const int lineWords = int(cacheLine / sizeof(uint64_t));
+		int w = 0, h = 0, stride = 0;
+		vector<uint64_t, CacheAllocator<uint64_t>> words;
+
+		class Bit
+		{
+			uint64_t& word;
+			uint64_t mask;
+		public:
+			Bit(uint64_t& w, const uint64_t m) : word(w), mask(m) {}
+			operator bool() const { return (word & mask) != 0; }
+			Bit& operator=(const bool value)
+			{
+				value ? word |= mask : word &= ~mask;
+				return *this;
+			}
+		};
+
+		struct Column
+		{
+			uint64_t * first;
+			int stride;
+			uint64_t mask;
+			Bit operator[](const int y) const { return { first[y * stride], mask }; }
+		};
+
+		struct ConstColumn
+		{
+			const uint64_t * first;
+			int stride;
+			uint64_t mask;
+			bool operator[](const int y) const { return (first[y * stride] & mask) != 0; }
+		};
+
+	public:
+		static int strideFor(const int width) { return ((width + 63) / 64 + lineWords - 1) / lineWords * lineWords; }
+		static size_t bytesFor(const int width, const int height) { return size_t(strideFor(width)) * size_t(height) * sizeof(uint64_t); }
+
+		void resize(const int width, const int height)
+		{
+			w = width, h = height;
+			stride = strideFor(width);
+			words.assign(size_t(stride) * size_t(height), 0);
+		}
+
+		int width() const { return w; }
+		int height() const { return h; }
+		bool contains(const int x, const int y) const { return x >= 0 && y >= 0 && x < w && y < h; }
+
+		Column operator[](const int x) { return { words.data() + x / 64, stride, uint64_t(1) << (x % 64) }; }
+		ConstColumn operator[](const int x) const { return { words.data() + x / 64, stride, uint64_t(1) << (x % 64) }; }
+
+		void * data() { return words.data(); }
+		const void * data() const { return words.data(); }
+		size_t bytes() const { return words.size() * sizeof(uint64_t); }
+	};
+}
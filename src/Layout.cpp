@@ -0,0 +1,382 @@
+#include "BWEB.h"
+#include "Layout.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace BWEB
+{
+	namespace {
+
+		// Read only view of a whole file, unmapped when it goes out of scope
+		class MappedFile
+		{
+			const char * data = nullptr;
+			size_t size = 0;
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+		public:
+			explicit MappedFile(const string& path)
+			{
+#ifdef _WIN32
+				file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				LARGE_INTEGER fileSize;
+				if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+					return;
+				mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (!mapping)
+					return;
+				data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				size = data ? size_t(fileSize.QuadPart) : 0;
+#else
+				fd = open(path.c_str(), O_RDONLY);
+				struct stat info;
+				if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+					return;
+				const auto view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (view == MAP_FAILED)
+					return;
+				data = static_cast<const char *>(view);
+				size = size_t(info.st_size);
+#endif
+			}
+
+			~MappedFile()
+			{
+#ifdef _WIN32
+				if (data) UnmapViewOfFile(data);
+				if (mapping) CloseHandle(mapping);
+				if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+				if (data) munmap(const_cast<char *>(data), size);
+				if (fd >= 0) close(fd);
+#endif
+			}
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			// Returns a pointer to count records at offset, or nullptr if they don't fit in the file
+			template <class T>
+			const T * at(const uint64_t offset, const uint64_t count = 1) const
+			{
+				if (!data || offset % alignof(T) != 0 || offset > size || count > (size - offset) / sizeof(T))
+					return nullptr;
+				return reinterpret_cast<const T *>(data + offset);
+			}
+		};
+
+		// Appends records to a byte buffer, every section starts 8 byte aligned
+		class LayoutWriter
+		{
+			vector<char> bytes;
+		public:
+			template <class T>
+			Layout::Section append(const T * first, const size_t count)
+			{
+				bytes.resize((bytes.size() + 7) & ~size_t(7));
+				const Layout::Section section{ bytes.size(), count };
+				const auto raw = reinterpret_cast<const char *>(first);
+				bytes.insert(bytes.end(), raw, raw + count * sizeof(T));
+				return section;
+			}
+
+			template <class T>
+			Layout::Section append(const vector<T>& records) { return append(records.data(), records.size()); }
+
+			template <class T>
+			T& get(const uint64_t offset) { return *reinterpret_cast<T *>(bytes.data() + offset); }
+
+			const vector<char>& data() const { return bytes; }
+		};
+
+		// BWEM numbers Areas from 1 in the order of Map::Areas
+		const BWEM::Area * findArea(const BWEM::Map& mapBWEM, const int id)
+		{
+			const auto& areas = mapBWEM.Areas();
+			return (id > 0 && id <= int(areas.size())) ? &areas[id - 1] : nullptr;
+		}
+
+		Layout::AreaRef areaRef(const BWEM::Area * area)
+		{
+			return area ? Layout::AreaRef{ area->Id(), -1 } : Layout::AreaRef();
+		}
+
+		Layout::AreaRef chokeRef(const BWEM::ChokePoint * choke)
+		{
+			if (!choke)
+				return {};
+			const auto area = choke->GetAreas().first;
+			const auto& chokes = area->ChokePoints();
+			return { area->Id(), int32_t(find(chokes.begin(), chokes.end(), choke) - chokes.begin()) };
+		}
+
+		Layout::AreaRef baseRef(const BWEM::Base * base)
+		{
+			if (!base)
+				return {};
+			const auto area = base->GetArea();
+			return { area->Id(), int32_t(base - area->Bases().data()) };
+		}
+
+		const BWEM::ChokePoint * findChoke(const BWEM::Map& mapBWEM, const Layout::AreaRef ref)
+		{
+			const auto area = findArea(mapBWEM, ref.area);
+			return (area && ref.index >= 0 && ref.index < int(area->ChokePoints().size())) ? area->ChokePoints()[ref.index] : nullptr;
+		}
+
+		const BWEM::Base * findBase(const BWEM::Map& mapBWEM, const Layout::AreaRef ref)
+		{
+			const auto area = findArea(mapBWEM, ref.area);
+			return (area && ref.index >= 0 && ref.index < int(area->Bases().size())) ? &area->Bases()[ref.index] : nullptr;
+		}
+
+		Layout::SlotRecord slotRecord(const TilePosition tile, const Footprint footprint)
+		{
+			return { tile.x, tile.y, uint8_t(footprint), {} };
+		}
+	}
+
+	bool Map::saveLayout(const string& path)
+	{
+		// The header is filled in last, grids come right after it and are stored exactly as they are in memory
+		LayoutWriter writer;
+		const Layout::Header blank{};
+		const auto headerOffset = writer.append(&blank, 1).offset;
+		const auto appendGrid = [&](const void * data, const size_t bytes) {
+			return writer.append(static_cast<const char *>(data), bytes);
+		};
+		const auto overlap = appendGrid(overlapGrid.data(), overlapGrid.bytes());
+		const auto reserve = appendGrid(reserveGrid.data(), reserveGrid.bytes());
+		const auto neutral = appendGrid(neutralGrid.data(), neutralGrid.bytes());
+		const auto owner = appendGrid(ownerGrid.data(), ownerGrid.bytes());
+		const auto layer = appendGrid(layerGrid.data(), layerGrid.bytes());
+
+		// Every slot lives in one section, the objects point into it
+		vector<Layout::SlotRecord> slots;
+		const auto appendSlots = [&](const SlotBuffer& buffer) {
+			const Layout::Section section{ slots.size(), buffer.size() };
+			for (size_t i = 0; i < buffer.size(); i++)
+				slots.push_back(slotRecord(buffer.tile(i), buffer.footprint(i)));
+			return section;
+		};
+
+		vector<Layout::StationRecord> stationRecords;
+		for (auto& station : stations) {
+			Layout::StationRecord record{ baseRef(station.BWEMBase()), station.ResourceCentroid().x, station.ResourceCentroid().y, station.Id(), 0, { slots.size(), station.DefenseLocations().size() } };
+			for (auto& tile : station.DefenseLocations())
+				slots.push_back(slotRecord(tile, Footprint::Defense));
+			stationRecords.push_back(record);
+		}
+
+		vector<Layout::BlockRecord> blockRecords;
+		for (auto& block : blocks)
+			blockRecords.push_back({ block.Location().x, block.Location().y, block.width(), block.height(), block.Id(), 0, appendSlots(block.Slots()) });
+
+		vector<Layout::WallRecord> wallRecords;
+		for (auto& wall : walls) {
+			const auto door = wall.getDoor();
+			const auto centroid = wall.getCentroid();
+			wallRecords.push_back({ areaRef(wall.getArea()), chokeRef(wall.getChokePoint()), door.x, door.y, centroid.x, centroid.y, wall.getId(), 0, appendSlots(wall.getSlots()) });
+		}
+
+		vector<Layout::AreaCount> generated;
+		for (auto& area : areasWithBlocks)
+			generated.push_back({ area->Id(), 1 });
+
+		vector<Layout::AreaCount> types;
+		for (auto& entry : typePerArea) {
+			if (entry.first)
+				types.push_back({ entry.first->Id(), entry.second });
+		}
+
+		Layout::Header header{};
+		header.magic = Layout::magic;
+		header.formatVersion = Layout::formatVersion;
+		header.headerSize = sizeof(Layout::Header);
+		header.gridWidth = overlapGrid.width(), header.gridHeight = overlapGrid.height();
+		const auto hash = game->mapHash();
+		memcpy(header.mapHash, hash.c_str(), min(hash.size(), sizeof(header.mapHash) - 1));
+		header.startX = mainTile.x, header.startY = mainTile.y;
+		header.race = selfRace().getID();
+		header.blockRace = blockRace.getID();
+		header.lazyBlocks = lazyBlocks;
+		header.nextId = nextId;
+		header.mainArea = areaRef(mainArea), header.naturalArea = areaRef(naturalArea);
+		header.mainChoke = chokeRef(mainChoke), header.naturalChoke = chokeRef(naturalChoke);
+		header.mainX = mainTile.x, header.mainY = mainTile.y;
+		header.naturalX = naturalTile.x, header.naturalY = naturalTile.y;
+		header.stations = writer.append(stationRecords);
+		header.blocks = writer.append(blockRecords);
+		header.walls = writer.append(wallRecords);
+		header.slots = writer.append(slots);
+		header.areasWithBlocks = writer.append(generated);
+		header.typePerArea = writer.append(types);
+		header.overlap = overlap, header.reserve = reserve, header.neutral = neutral, header.owner = owner, header.layer = layer;
+		writer.get<Layout::Header>(headerOffset) = header;
+
+		ofstream file(path, ios::binary | ios::trunc);
+		file.write(writer.data().data(), streamsize(writer.data().size()));
+		return bool(file);
+	}
+
+	bool Map::loadLayout(const string& path)
+	{
+		const MappedFile file(path);
+		const auto header = file.at<Layout::Header>(0);
+		if (!header
+			|| header->magic != Layout::magic
+			|| header->formatVersion != Layout::formatVersion
+			|| header->headerSize != sizeof(Layout::Header)
+			|| header->gridWidth != game->mapWidth()
+			|| header->gridHeight != game->mapHeight())
+			return false;
+
+		// The layout only holds for the map, start location and race it was made for
+		const auto hash = game->mapHash();
+		if (strncmp(header->mapHash, hash.c_str(), sizeof(header->mapHash)) != 0
+			|| TilePosition(header->startX, header->startY) != startLocation()
+			|| header->race != selfRace().getID())
+			return false;
+
+		const auto width = header->gridWidth, height = header->gridHeight;
+		const auto gridFits = [&](const Layout::Section section, const size_t bytes) {
+			return section.count == bytes && file.at<char>(section.offset, section.count);
+		};
+		if (!gridFits(header->overlap, Grid<uint8_t>::bytesFor(width, height))
+			|| !gridFits(header->reserve, BitGrid::bytesFor(width, height))
+			|| !gridFits(header->neutral, Grid<NeutralTile>::bytesFor(width, height))
+			|| !gridFits(header->owner, Grid<Owner>::bytesFor(width, height))
+			|| !gridFits(header->layer, Grid<LayerMask>::bytesFor(width, height)))
+			return false;
+
+		const auto stationRecords = file.at<Layout::StationRecord>(header->stations.offset, header->stations.count);
+		const auto blockRecords = file.at<Layout::BlockRecord>(header->blocks.offset, header->blocks.count);
+		const auto wallRecords = file.at<Layout::WallRecord>(header->walls.offset, header->walls.count);
+		const auto slots = file.at<Layout::SlotRecord>(header->slots.offset, header->slots.count);
+		const auto generated = file.at<Layout::AreaCount>(header->areasWithBlocks.offset, header->areasWithBlocks.count);
+		const auto types = file.at<Layout::AreaCount>(header->typePerArea.offset, header->typePerArea.count);
+		if (!stationRecords || !blockRecords || !wallRecords || !slots || !generated || !types)
+			return false;
+
+		const auto slotsOf = [&](const Layout::Section section) {
+			return section.offset <= header->slots.count && section.count <= header->slots.count - section.offset;
+		};
+		for (uint64_t i = 0; i < header->stations.count; i++) {
+			if (!slotsOf(stationRecords[i].defenses) || !findBase(mapBWEM, stationRecords[i].base))
+				return false;
+		}
+		for (uint64_t i = 0; i < header->blocks.count; i++) {
+			if (!slotsOf(blockRecords[i].slots))
+				return false;
+		}
+		for (uint64_t i = 0; i < header->walls.count; i++) {
+			if (!slotsOf(wallRecords[i].slots) || !findArea(mapBWEM, wallRecords[i].area.area) || !findChoke(mapBWEM, wallRecords[i].choke))
+				return false;
+		}
+
+		// Everything checks out, replace the current layout, sizing the grids also drops every reservation
+		// Used tiles stay, they are the buildings of this game like they are for onStart
+		sizeGrids();
+		const auto copyGrid = [&](void * grid, const Layout::Section section) {
+			memcpy(grid, file.at<char>(section.offset, section.count), size_t(section.count));
+		};
+		copyGrid(overlapGrid.data(), header->overlap);
+		copyGrid(reserveGrid.data(), header->reserve);
+		copyGrid(neutralGrid.data(), header->neutral);
+		copyGrid(ownerGrid.data(), header->owner);
+		copyGrid(layerGrid.data(), header->layer);
+
+		mainTile = TilePosition(header->mainX, header->mainY);
+		mainPosition = static_cast<Position>(mainTile) + Position(64, 48);
+		naturalTile = TilePosition(header->naturalX, header->naturalY);
+		naturalPosition = static_cast<Position>(naturalTile) + Position(64, 48);
+		mainArea = findArea(mapBWEM, header->mainArea.area);
+		naturalArea = findArea(mapBWEM, header->naturalArea.area);
+		mainChoke = findChoke(mapBWEM, header->mainChoke);
+		naturalChoke = findChoke(mapBWEM, header->naturalChoke);
+
+		smallSlots = SlotIndex(2, 2), mediumSlots = SlotIndex(3, 2), largeSlots = SlotIndex(4, 3), defenseSlots = SlotIndex(2, 2);
+		stations.clear(), blocks.clear(), walls.clear();
+
+		for (uint64_t i = 0; i < header->stations.count; i++) {
+			const auto& record = stationRecords[i];
+			set<TilePosition> defenses;
+			for (uint64_t j = record.defenses.offset; j < record.defenses.offset + record.defenses.count; j++) {
+				defenses.insert(TilePosition(slots[j].x, slots[j].y));
+				insertSlot(defenseSlots, TilePosition(slots[j].x, slots[j].y));
+			}
+			Station station(Position(record.centroidX, record.centroidY), defenses, findBase(mapBWEM, record.base));
+			station.setId(record.id);
+			stations.push_back(station);
+		}
+
+		for (uint64_t i = 0; i < header->blocks.count; i++) {
+			const auto& record = blockRecords[i];
+			Block block(record.w, record.h, TilePosition(record.x, record.y));
+			block.setId(record.id);
+			for (uint64_t j = record.slots.offset; j < record.slots.offset + record.slots.count; j++) {
+				const TilePosition tile(slots[j].x, slots[j].y);
+				switch (Footprint(slots[j].footprint)) {
+				case Footprint::Small: block.insertSmall(tile); break;
+				case Footprint::Medium: block.insertMedium(tile); break;
+				case Footprint::Large: block.insertLarge(tile); break;
+				default: break;
+				}
+			}
+			insertSlots(block);
+			blocks.push_back(block);
+		}
+
+		for (uint64_t i = 0; i < header->walls.count; i++) {
+			const auto& record = wallRecords[i];
+			Wall wall(findArea(mapBWEM, record.area.area), findChoke(mapBWEM, record.choke));
+			wall.setId(record.id);
+			wall.setWallDoor(TilePosition(record.doorX, record.doorY));
+			wall.setCentroid(Position(record.centroidX, record.centroidY));
+			for (uint64_t j = record.slots.offset; j < record.slots.offset + record.slots.count; j++) {
+				const TilePosition tile(slots[j].x, slots[j].y);
+				wall.insertSegment(tile, Footprint(slots[j].footprint));
+				if (Footprint(slots[j].footprint) == Footprint::Defense)
+					insertSlot(defenseSlots, tile);
+			}
+			walls.push_back(wall);
+		}
+
+		areasWithBlocks.clear();
+		for (uint64_t i = 0; i < header->areasWithBlocks.count; i++) {
+			if (const auto area = findArea(mapBWEM, generated[i].area))
+				areasWithBlocks.insert(area);
+		}
+
+		typePerArea.clear();
+		for (uint64_t i = 0; i < header->typePerArea.count; i++) {
+			if (const auto area = findArea(mapBWEM, types[i].area))
+				typePerArea[area] = types[i].count;
+		}
+
+		blockRace = Race(header->blockRace);
+		lazyBlocks = header->lazyBlocks != 0;
+		nextId = header->nextId;
+		dirtyRegions.clear();
+		buildConnectivity();
+
+		blocksChanged = wallsChanged = stationsChanged = true;
+		overlapChanged = reserveChanged = neutralChanged = usedTilesChanged = slotsChanged = true;
+		publish();
+		return true;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include "BWEB.h"
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// On disk format of a saved layout, every record is plain data and every BWEM pointer is stored as an index so the file can be mapped anywhere
+	namespace Layout
+	{
+		const uint32_t magic = 0x42455742;	// "BWEB"
+		const uint32_t formatVersion = 3;
+
+		// Reference to a BWEM::Area by id, or to a BWEM::Base / BWEM::ChokePoint by its index within that Area, -1 for nullptr
+		struct AreaRef { int32_t area = -1; int32_t index = -1; };
+
+		// Contiguous run of records that starts at a byte offset from the start of the file
+		struct Section { uint64_t offset = 0; uint64_t count = 0; };
+
+		// Padding is spelled out so a record made with {} writes no uninitialised bytes
+		struct SlotRecord { int32_t x, y; uint8_t footprint; uint8_t padding[3]; };
+		struct StationRecord { AreaRef base; int32_t centroidX, centroidY; int32_t id; int32_t padding; Section defenses; };
+		struct BlockRecord { int32_t x, y, w, h, id; int32_t padding; Section slots; };
+		struct WallRecord { AreaRef area, choke; int32_t doorX, doorY, centroidX, centroidY, id; int32_t padding; Section slots; };
+		struct AreaCount { int32_t area, count; };
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t formatVersion;
+			uint32_t headerSize;		// Guards against a file written by a build with different record layouts
+			int32_t gridWidth, gridHeight;
+			char mapHash[64];
+			int32_t startX, startY;
+			int32_t race;
+			int32_t blockRace;
+			int32_t lazyBlocks;
+			int32_t nextId;
+			AreaRef mainArea, naturalArea, mainChoke, naturalChoke;
+			int32_t mainX, mainY, naturalX, naturalY;
+			int32_t padding;
+			Section stations, blocks, walls, slots, areasWithBlocks, typePerArea;
+			Section overlap, reserve, neutral, owner, layer;	// Raw grid storage, count is in bytes
+		};
+
+		static_assert(sizeof(SlotRecord) == 12 && sizeof(StationRecord) == 40 && sizeof(BlockRecord) == 40 && sizeof(WallRecord) == 56, "Records can't have implicit padding");
+		static_assert(sizeof(Header) == 160 + 11 * sizeof(Section), "The header can't have implicit padding");
+	}
+}
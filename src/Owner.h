@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include "Grid.h"
+
+namespace BWEB
+{
+	using namespace std;
+
+	// Kind of BWEB object that owns a tile
+	enum class OwnerType : unsigned char { None, Station, StationDefense, Mining, Reserved, Wall, WallDefense, Block, Neutral, Count };
+
+	// Handle of the BWEB object that owns a tile, id is the object's id (the BWAPI id for neutrals)
+	struct Owner
+	{
+		OwnerType type = OwnerType::None;
+		int id = -1;
+		bool operator==(const Owner& other) const { return type == other.type && id == other.id; }
+	};
+
+	// One bit for every kind of owner on a tile
+	using LayerMask = uint16_t;
+	static_assert(int(OwnerType::Count) <= int(sizeof(LayerMask)) * 8, "Every OwnerType needs a bit in LayerMask");
+
+	inline LayerMask layerBit(const OwnerType type) { return LayerMask(1u << int(type)); }
+
+	// Layers units can't walk through, mining and reserved tiles are kept clear of buildings so units still walk through them
+	const LayerMask solidLayers = LayerMask(layerBit(OwnerType::Station) | layerBit(OwnerType::StationDefense) | layerBit(OwnerType::Wall) | layerBit(OwnerType::WallDefense) | layerBit(OwnerType::Block) | layerBit(OwnerType::Neutral));
+
+	// Records an owner on a tile, the first owner of a tile stays the one getOwner returns
+	inline void addOwner(Grid<Owner>& owners, Grid<LayerMask>& layers, const int x, const int y, const Owner owner)
+	{
+		if (owner.type == OwnerType::None)
+			return;
+		layers[x][y] |= layerBit(owner.type);
+		if (owners[x][y].type == OwnerType::None)
+			owners[x][y] = owner;
+	}
+
+	// Clears one kind of owner from a tile, returns true when that kind was the tile's owner and other layers are left to find a new one in
+	inline bool removeOwner(Grid<Owner>& owners, Grid<LayerMask>& layers, const int x, const int y, const OwnerType type)
+	{
+		if ((layers[x][y] & layerBit(type)) == 0)
+			return false;
+		layers[x][y] &= LayerMask(~layerBit(type));
+		if (layers[x][y] == 0) {
+			owners[x][y] = Owner();
+			return false;
+		}
+		return owners[x][y].type == type;
+	}
+}
@@ -1,89 +1,117 @@
 #include "BWEB.h"
+#include "Snapshot.h"
+#include "Trace.h"
 
 using namespace std::placeholders;
 
 namespace BWEB
 {
-	vector<TilePosition> Map::findPath(BWEM::Map& bwem, BWEB::Map& bweb, const TilePosition source, const TilePosition target, bool ignoreOverlap, bool ignoreWalls, bool diagonal)
+	namespace
 	{
-		struct Node {
-			Node(TilePosition const tile, int const dist, TilePosition const parent) : tile{ tile }, dist{ dist }, parent{ parent } { }
-			mutable TilePosition tile = TilePositions::None;
-			mutable int dist;
-			mutable TilePosition parent;
-		};
-
-		const auto manhattan = [](const TilePosition source, const TilePosition target) {
-			return abs(source.x - target.x) + abs(source.y - target.y);
-		};
-
-		const auto collision = [](BWEB::Map& bweb, const TilePosition tile, bool ignoreOverlap, bool ignoreWalls) {
-			return !tile.isValid()
-				|| (!ignoreOverlap && bweb.overlapGrid[tile.x][tile.y] > 0)
-				|| !bweb.isWalkable(tile)
-				|| (!ignoreWalls && bweb.overlapsCurrentWall(tile) != UnitTypes::None);
-		};
-
-		const auto createPath = [](const Node& current, const TilePosition source, const TilePosition target, TilePosition parentGrid[256][256]) {
-			vector<TilePosition> path;
-			path.push_back(target);
-			TilePosition check = current.parent;
-
-			do {
-				path.push_back(check);
-				check = parentGrid[check.x][check.y];
-			} while (check != source);
-			return path;
-		};
-
-		auto const direction = [diagonal]() {
-			vector<TilePosition> vec{ { 0, 1 },{ 1, 0 },{ -1, 0 },{ 0, -1 } };
-			vector<TilePosition> diag{ { -1,-1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } };
-			if (diagonal) {
-				vec.insert(vec.end(), diag.begin(), diag.end());
-			}
-			return vec;
-		}();
-
-		std::queue<Node> nodeQueue;
-		nodeQueue.emplace(source, 0, source);
-		TilePosition parentGrid[256][256];
-		for (int i = 0; i < 256; ++i) {
-			for (int j = 0; j < 256; ++j) {
-				parentGrid[i][j] = BWAPI::TilePositions::None;
-			}
-		}
-
-		// While not empty, pop off top the closest TilePosition to target
-		while (!nodeQueue.empty()) {
-			auto const current = nodeQueue.front();
-			nodeQueue.pop();
-
-			// If at target, return path
-			if (current.tile == target)
-				return createPath(current, source, target, parentGrid);
-
-
-			// If already has a parent, continue
-			auto const tile = current.tile;
-			if (parentGrid[tile.x][tile.y] != BWAPI::TilePositions::None)
-				continue;
-			// Set parent
-			parentGrid[tile.x][tile.y] = current.parent;
-
-			for (auto const &d : direction) {
-				auto const next = current.tile + d;
-				if (next.isValid()) {
-
-					// If next has parent or is a collision, continue
-					if (parentGrid[next.x][next.y] != BWAPI::TilePositions::None || collision(bweb, next, ignoreOverlap, ignoreWalls))
-						continue;
-
-					nodeQueue.emplace(next, current.dist + manhattan(current.tile, target) + 1,  tile);
+		template <class Collision>
+		vector<TilePosition> tilePath(BWAPI::Game * game, const TilePosition source, const TilePosition target, bool diagonal, Collision collision, uint64_t& expanded)
+		{
+			struct Node {
+				Node(TilePosition const tile, int const dist, TilePosition const parent, uint8_t const code) : tile{ tile }, dist{ dist }, parent{ parent }, code{ code } { }
+				mutable TilePosition tile = TilePositions::None;
+				mutable int dist;
+				mutable TilePosition parent;
+				mutable uint8_t code;
+			};
+
+			auto const direction = [diagonal]() {
+				vector<TilePosition> vec{ { 0, 1 },{ 1, 0 },{ -1, 0 },{ 0, -1 } };
+				vector<TilePosition> diag{ { -1,-1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } };
+				if (diagonal) {
+					vec.insert(vec.end(), diag.begin(), diag.end());
+				}
+				return vec;
+			}();
+
+			// Every visited tile stores the direction it was reached from instead of its parent, 0 is unvisited
+			const uint8_t root = 0xFF;
+			Grid<uint8_t> parentGrid;
+			parentGrid.resize(game->mapWidth(), game->mapHeight());
+
+			const auto manhattan = [](const TilePosition source, const TilePosition target) {
+				return abs(source.x - target.x) + abs(source.y - target.y);
+			};
+
+			const auto createPath = [&](const Node& current) {
+				vector<TilePosition> path;
+				path.push_back(target);
+				TilePosition check = current.parent;
+
+				do {
+					path.push_back(check);
+					const auto code = parentGrid[check.x][check.y];
+					check = code == root ? source : check - direction[code - 1];
+				} while (check != source);
+				return path;
+			};
+
+			std::queue<Node> nodeQueue;
+			nodeQueue.emplace(source, 0, source, root);
+
+			// While not empty, pop off top the closest TilePosition to target
+			while (!nodeQueue.empty()) {
+				auto const current = nodeQueue.front();
+				nodeQueue.pop();
+				expanded++;
+
+				// If at target, return path
+				if (current.tile == target)
+					return createPath(current);
+
+
+				// If already has a parent, continue
+				auto const tile = current.tile;
+				if (parentGrid[tile.x][tile.y] != 0)
+					continue;
+				// Set parent
+				parentGrid[tile.x][tile.y] = current.code;
+
+				for (size_t i = 0; i < direction.size(); i++) {
+					auto const next = current.tile + direction[i];
+					if (next.isValid()) {
+
+						// If next has parent or is a collision, continue
+						if (parentGrid[next.x][next.y] != 0 || collision(next))
+							continue;
+
+						nodeQueue.emplace(next, current.dist + manhattan(current.tile, target) + 1, tile, uint8_t(i + 1));
+					}
 				}
 			}
+
+			return {};
 		}
+	}
 
-		return {};
+	vector<TilePosition> Map::findPath(BWEM::Map& bwem, const BWEB::Map& bweb, const TilePosition source, const TilePosition target, bool ignoreOverlap, bool ignoreWalls, bool diagonal) const
+	{
+		BWEB_TRACE_ZONE("findPath", frame());
+		ScopedTimer timer(stats, Timer::FindPath);
+		if (busy(Subsystem::Blocks))
+			return {};
+		uint64_t expanded = 0;
+		auto path = tilePath(bweb.game, source, target, diagonal, [&](const TilePosition tile) {
+			return !bweb.overlapGrid.contains(tile.x, tile.y)
+				|| (!ignoreOverlap && bweb.overlapGrid[tile.x][tile.y] > 0)
+				|| !bweb.isWalkable(tile)
+				|| (!ignoreWalls && bweb.overlapsCurrentWall(tile) != UnitTypes::None);
+		}, expanded);
+		stats.count(Counter::PathNodes, expanded);
+		return path;
+	}
+
+	vector<TilePosition> Snapshot::findPath(const TilePosition source, const TilePosition target, bool ignoreOverlap, bool diagonal) const
+	{
+		uint64_t expanded = 0;
+		return tilePath(game, source, target, diagonal, [&](const TilePosition tile) {
+			return !occupancy->overlap.contains(tile.x, tile.y)
+				|| (!ignoreOverlap && occupancy->overlap[tile.x][tile.y] > 0)
+				|| !Map::isWalkable(game, tile);
+		}, expanded);
 	}
 }
\ No newline at end of file
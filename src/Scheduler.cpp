@@ -0,0 +1,54 @@
+#include "Scheduler.h"
+#include <chrono>
+
+namespace BWEB
+{
+	void Scheduler::push(const Priority priority, function<bool()> step)
+	{
+		queues[int(priority)].push_back(move(step));
+	}
+
+	bool Scheduler::next()
+	{
+		if (current)
+			return true;
+		for (auto& queue : queues) {
+			if (!queue.empty()) {
+				current = move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool Scheduler::run(const double budgetMs)
+	{
+		if (budgetMs <= 0.0)
+			return size() > 0;
+
+		// The clock is checked between steps, so a frame overruns the budget by at most one step
+		const auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(budgetMs));
+		do {
+			if (!next())
+				return false;
+			if (current())
+				current = nullptr;
+		} while (chrono::steady_clock::now() < deadline);
+		return size() > 0;
+	}
+
+	void Scheduler::finish()
+	{
+		while (current && !current()) {}
+		current = nullptr;
+	}
+
+	size_t Scheduler::size() const
+	{
+		auto count = size_t(current ? 1 : 0);
+		for (auto& queue : queues)
+			count += queue.size();
+		return count;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <functional>
+
+namespace BWEB
+{
+	using namespace std;
+
+	// Order queued jobs are started in, jobs of the same priority start in the order they were queued
+	enum class Priority : unsigned char { High, Normal, Low, Count };
+
+	// Runs queued jobs one small step at a time until a time budget is spent, a step returns true once its job is done
+	// A started job is stepped until it is done before any other job starts, so a job can keep its state in the Map between steps
+	class Scheduler
+	{
+		deque<function<bool()>> queues[int(Priority::Count)];
+		function<bool()> current;
+
+		bool next();
+
+	public:
+		void push(Priority priority, function<bool()> step);
+
+		// Steps jobs until the budget is spent, at least one step runs for any positive budget, returns true while work remains
+		bool run(double budgetMs);
+
+		// Steps the started job until it is done, used before a synchronous call that needs the same state
+		void finish();
+
+		bool running() const { return bool(current); }
+		size_t size() const;
+	};
+}
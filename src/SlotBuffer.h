@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <set>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+#include <BWAPI.h>
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Footprint classes of the slots BWEB lays out, ordered the way they are stored
+	enum class Footprint : unsigned char { Small, Medium, Large, Defense };
+
+	// Returns the size in tiles of a footprint class
+	inline TilePosition footprintSize(const Footprint footprint)
+	{
+		switch (footprint) {
+		case Footprint::Medium: return { 3, 2 };
+		case Footprint::Large: return { 4, 3 };
+		default: return { 2, 2 };
+		}
+	}
+
+	// Returns the footprint class a building of this UnitType fits in
+	inline Footprint footprintOf(UnitType type)
+	{
+		if (type.tileWidth() >= 4) return Footprint::Large;
+		if (type.tileWidth() >= 3) return Footprint::Medium;
+		return Footprint::Small;
+	}
+
+	// Non-owning view over a contiguous run of TilePositions
+	class TileRange
+	{
+		const TilePosition * first = nullptr;
+		const TilePosition * last = nullptr;
+	public:
+		TileRange() = default;
+		TileRange(const TilePosition * f, const TilePosition * l) : first(f), last(l) {}
+		const TilePosition * begin() const { return first; }
+		const TilePosition * end() const { return last; }
+		size_t size() const { return size_t(last - first); }
+		bool empty() const { return first == last; }
+
+		// Kept for bots written against the old accessors that returned a copy
+		[[deprecated("Iterate the TileRange instead of copying it into a set")]]
+		operator set<TilePosition>() const { return set<TilePosition>(first, last); }
+	};
+
+	// Returns the object with the given id, objects are stored in the order their ids were handed out
+	template <class T, class GetId>
+	const T * findById(const vector<T>& objects, const int id, GetId getId)
+	{
+		const auto it = lower_bound(objects.begin(), objects.end(), id, [&](const T& object, const int value) { return getId(object) < value; });
+		return (it != objects.end() && getId(*it) == id) ? &*it : nullptr;
+	}
+
+	// Struct of arrays holding the slots of one BWEB object, grouped by footprint so every footprint is one contiguous range
+	class SlotBuffer
+	{
+		vector<TilePosition> tiles;
+		vector<Footprint> footprints;
+		int owner = -1;
+	public:
+		size_t size() const { return tiles.size(); }
+		TilePosition tile(size_t i) const { return tiles[i]; }
+		Footprint footprint(size_t i) const { return footprints[i]; }
+
+		// Returns the id of the BWEB object that owns these slots
+		int getOwner() const { return owner; }
+		void setOwner(int id) { owner = id; }
+
+		// Returns every slot
+		TileRange all() const { return { tiles.data(), tiles.data() + tiles.size() }; }
+
+		// Returns the slots of one footprint class
+		TileRange of(const Footprint footprint) const
+		{
+			const auto range = equal_range(footprints.begin(), footprints.end(), footprint);
+			const auto first = tiles.data() + (range.first - footprints.begin());
+			const auto last = tiles.data() + (range.second - footprints.begin());
+			return { first, last };
+		}
+
+		void insert(const TilePosition here, const Footprint footprint)
+		{
+			const auto range = equal_range(footprints.begin(), footprints.end(), footprint);
+			const auto first = tiles.begin() + (range.first - footprints.begin());
+			const auto last = tiles.begin() + (range.second - footprints.begin());
+			if (find(first, last, here) != last)
+				return;
+
+			const auto offset = range.second - footprints.begin();
+			tiles.insert(tiles.begin() + offset, here);
+			footprints.insert(footprints.begin() + offset, footprint);
+		}
+	};
+
+	// Index of slots with one footprint, kept up to date as buildings appear and disappear
+	struct SlotIndex
+	{
+		SlotIndex(int w, int h) : width(w), height(h) {}
+		int width, height;
+		set<TilePosition> slots;	// Every slot with this footprint
+		set<TilePosition> free;		// Slots with no used tiles inside their footprint
+	};
+
+	// Returns the free slot closest to the search center that passes the placeable check
+	// Note: This is a sweep over the free slots ordered by x, pruned once the horizontal distance alone can't beat the best slot.
+	// Slots near the search center are found in a few steps, but a column of free slots that all fail the placeable check makes it linear in the free slots.
+	template <class Placeable>
+	TilePosition closestSlot(const SlotIndex& index, const TilePosition searchCenter, Placeable placeable)
+	{
+		auto distBest = DBL_MAX;
+		auto tileBest = TilePositions::Invalid;
+		const auto check = [&](const TilePosition tile) {
+			const auto dist = tile.getDistance(searchCenter);
+			if (dist < distBest && placeable(tile))
+				distBest = dist, tileBest = tile;
+		};
+
+		// Free slots are ordered by x, walk outwards from the search center until the horizontal distance alone can't beat the best
+		const auto pivot = index.free.lower_bound(TilePosition(searchCenter.x, INT_MIN));
+		for (auto it = pivot; it != index.free.end() && it->x - searchCenter.x < distBest; ++it)
+			check(*it);
+		for (auto it = pivot; it != index.free.begin() && searchCenter.x - prev(it)->x < distBest; --it)
+			check(*prev(it));
+		return tileBest;
+	}
+}
@@ -0,0 +1,118 @@
+#include "Snapshot.h"
+
+namespace BWEB
+{
+	const SlotIndex& Snapshot::blockSlots(const Footprint footprint) const
+	{
+		if (footprint == Footprint::Large) return slots->largeSlots;
+		if (footprint == Footprint::Medium) return slots->mediumSlots;
+		return slots->smallSlots;
+	}
+
+	bool Snapshot::overlapsLayer(const TilePosition here, const OwnerType type) const
+	{
+		return occupancy->layer.contains(here.x, here.y) && (occupancy->layer[here.x][here.y] & layerBit(type)) != 0;
+	}
+
+	bool Snapshot::overlapsStations(const TilePosition here) const
+	{
+		return overlapsLayer(here, OwnerType::Station) || overlapsLayer(here, OwnerType::StationDefense);
+	}
+
+	bool Snapshot::overlapsBlocks(const TilePosition here) const
+	{
+		return overlapsLayer(here, OwnerType::Block);
+	}
+
+	bool Snapshot::overlapsMining(const TilePosition here) const
+	{
+		return overlapsLayer(here, OwnerType::Mining);
+	}
+
+	bool Snapshot::overlapsWalls(const TilePosition here) const
+	{
+		return overlapsLayer(here, OwnerType::Wall) || overlapsLayer(here, OwnerType::WallDefense);
+	}
+
+	bool Snapshot::overlapsAnything(const TilePosition here, const int width, const int height) const
+	{
+		for (auto x = here.x; x < here.x + width; x++) {
+			for (auto y = here.y; y < here.y + height; y++) {
+				if (!occupancy->overlap.contains(x, y))
+					continue;
+				if (occupancy->overlap[x][y] > 0)
+					return true;
+			}
+		}
+		return false;
+	}
+
+	bool Snapshot::isPlaceable(UnitType type, const TilePosition location) const
+	{
+		// Same checks as the Map, except for resource depots which need the live game to check
+		const auto creepCheck = type.requiresCreep();
+		for (auto x = location.x; x < location.x + type.tileWidth(); x++) {
+
+			if (creepCheck) {
+				TilePosition tile(x, location.y + 2);
+				if (!game->isBuildable(tile))
+					return false;
+			}
+
+			for (auto y = location.y; y < location.y + type.tileHeight(); y++) {
+				TilePosition tile(x, y);
+				if (!occupancy->overlap.contains(x, y) || !game->isBuildable(tile)) return false;
+				if (usedTiles->find(tile) != usedTiles->end()) return false;
+				if ((*reserve)[x][y]) return false;
+			}
+		}
+		return true;
+	}
+
+	TilePosition Snapshot::getBuildPosition(UnitType type, const TilePosition searchCenter) const
+	{
+		return closestSlot(blockSlots(footprintOf(type)), searchCenter, [&](const TilePosition tile) { return isPlaceable(type, tile); });
+	}
+
+	TilePosition Snapshot::getDefBuildPosition(UnitType type, const TilePosition searchCenter) const
+	{
+		return closestSlot(slots->defenseSlots, searchCenter, [&](const TilePosition tile) { return isPlaceable(type, tile); });
+	}
+
+	const Station* Snapshot::getClosestStation(const TilePosition here) const
+	{
+		auto distBest = DBL_MAX;
+		const Station* bestStation = nullptr;
+		for (auto& station : *stations) {
+			const auto dist = here.getDistance(station.BWEMBase()->Location());
+			if (dist < distBest)
+				distBest = dist, bestStation = &station;
+		}
+		return bestStation;
+	}
+
+	const Wall* Snapshot::getClosestWall(const TilePosition here) const
+	{
+		auto distBest = DBL_MAX;
+		const Wall* bestWall = nullptr;
+		for (auto& wall : *walls) {
+			const auto dist = here.getDistance(static_cast<TilePosition>(wall.getChokePoint()->Center()));
+			if (dist < distBest)
+				distBest = dist, bestWall = &wall;
+		}
+		return bestWall;
+	}
+
+	const Block* Snapshot::getClosestBlock(const TilePosition here) const
+	{
+		auto distBest = DBL_MAX;
+		const Block* bestBlock = nullptr;
+		for (auto& block : *blocks) {
+			const auto tile = block.Location() + TilePosition(block.width() / 2, block.height() / 2);
+			const auto dist = here.getDistance(tile);
+			if (dist < distBest)
+				distBest = dist, bestBlock = &block;
+		}
+		return bestBlock;
+	}
+}
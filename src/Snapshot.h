@@ -0,0 +1,90 @@
+#pragma once
+#include "BWEB.h"
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Immutable copy of the BWEB layout, published by the Map every time the layout changes
+	class Snapshot
+	{
+		friend class Map;
+
+		// Grids that always change together
+		struct Occupancy
+		{
+			Grid<uint8_t> overlap;
+			Grid<Owner> owner;
+			Grid<LayerMask> layer;
+		};
+
+		struct Slots
+		{
+			SlotIndex smallSlots{ 2, 2 }, mediumSlots{ 3, 2 }, largeSlots{ 4, 3 }, defenseSlots{ 2, 2 };
+		};
+
+		unsigned long long version = 0;
+		BWAPI::Game * game{};
+		shared_ptr<const vector<Block>> blocks;
+		shared_ptr<const vector<Wall>> walls;
+		shared_ptr<const vector<Station>> stations;
+		shared_ptr<const Occupancy> occupancy;
+		shared_ptr<const BitGrid> reserve;
+		shared_ptr<const Grid<NeutralTile>> neutral;
+		shared_ptr<const set<TilePosition>> usedTiles;
+		shared_ptr<const Slots> slots;
+		TilePosition mainTile, naturalTile;
+		const BWEM::Area * mainArea{};
+		const BWEM::Area * naturalArea{};
+		const BWEM::ChokePoint * mainChoke{};
+		const BWEM::ChokePoint * naturalChoke{};
+
+		Snapshot() {}
+		const SlotIndex& blockSlots(Footprint) const;
+		bool overlapsLayer(TilePosition, OwnerType) const;
+
+	public:
+		// Returns the version of this snapshot, every new snapshot has a higher version
+		unsigned long long getVersion() const { return version; }
+
+		// Returns every BWEB::Block, BWEB::Wall and BWEB::Station as they were when this snapshot was published
+		const vector<Block>& Blocks() const { return *blocks; }
+		const vector<Wall>& getWalls() const { return *walls; }
+		const vector<Station>& Stations() const { return *stations; }
+
+		// Returns the set of used TilePositions
+		const set<TilePosition>& getUsedTiles() const { return *usedTiles; }
+
+		TilePosition getMain() const { return mainTile; }
+		TilePosition getNatural() const { return naturalTile; }
+		const BWEM::Area * getMainArea() const { return mainArea; }
+		const BWEM::Area * getNaturalArea() const { return naturalArea; }
+		const BWEM::ChokePoint * getMainChoke() const { return mainChoke; }
+		const BWEM::ChokePoint * getNaturalChoke() const { return naturalChoke; }
+
+		Owner getOwner(TilePosition here) const { return occupancy->owner.contains(here.x, here.y) ? occupancy->owner[here.x][here.y] : Owner(); }
+		bool overlapsBlocks(TilePosition) const;
+		bool overlapsStations(TilePosition) const;
+		bool overlapsMining(TilePosition) const;
+		bool overlapsNeutrals(TilePosition here) const { return getNeutral(here).type != NeutralType::None; }
+		NeutralTile getNeutral(TilePosition here) const { return neutral->contains(here.x, here.y) ? (*neutral)[here.x][here.y] : NeutralTile(); }
+		bool overlapsWalls(TilePosition) const;
+		bool overlapsAnything(TilePosition here, int width = 1, int height = 1) const;
+		bool isPlaceable(UnitType, TilePosition) const;
+
+		// Same as Map::getBuildPosition, without building Blocks lazily
+		// Slots reserved by Map::getBuildPositions are left out as they were at publish time, a reservation that ran out since stays out until the next snapshot
+		TilePosition getBuildPosition(UnitType type, TilePosition searchCenter) const;
+
+		// Same as Map::getDefBuildPosition
+		TilePosition getDefBuildPosition(UnitType type, TilePosition searchCenter) const;
+
+		// Same as Map::findPath, without taking a wall that is currently being searched into account
+		vector<TilePosition> findPath(TilePosition source, TilePosition target, bool ignoreOverlap = false, bool diagonal = false) const;
+
+		const Station* getClosestStation(TilePosition) const;
+		const Wall* getClosestWall(TilePosition) const;
+		const Block* getClosestBlock(TilePosition) const;
+	};
+}
@@ -1,4 +1,5 @@
 #include "Station.h"
+#include "Trace.h"
 
 namespace BWEB
 {
@@ -11,6 +12,7 @@ namespace BWEB
 
 	void Map::findStations()
 	{
+		BWEB_TRACE_ZONE("findStations", frame());
 		for (auto& area : mapBWEM.Areas())
 		{
 			for (auto& base : area.Bases())
@@ -45,34 +47,43 @@ namespace BWEB
 				for (auto& m : base.Minerals()) { minerals.insert(m->Unit()); }
 				for (auto& g : base.Geysers()) { geysers.insert(g->Unit()); }
 
-				const Station newStation(genCenter, stationDefenses(base.Location(), h, v), &base);
+				Station newStation(genCenter, stationDefenses(base.Location(), h, v), &base);
+				newStation.setId(nextId++);
 				stations.push_back(newStation);
-				addOverlap(base.Location(), 4, 3);
+				stationsChanged = true;
+				for (auto& tile : newStation.DefenseLocations()) {
+					insertSlot(defenseSlots, tile);
+					addOverlap(tile, 2, 2, Owner{ OwnerType::StationDefense, newStation.Id() });
+				}
+				addOverlap(base.Location(), 4, 3, Owner{ OwnerType::Station, newStation.Id() });
 
+				// Resources and the space just around them
 				TilePosition start(genCenter);
 				for (int x = start.x - 4; x < start.x + 4; x++) {
 					for (int y = start.y - 4; y < start.y + 4; y++) {
 						TilePosition t(x, y);
 						if (!t.isValid()) continue;
-						if (t.getDistance(start) < 4)
-							addOverlap(t,1,1);
+						if (t.getDistance(start) < 3)
+							addOverlap(t, 1, 1, Owner{ OwnerType::Mining, newStation.Id() });
+						else if (t.getDistance(start) < 4)
+							addOverlap(t, 1, 1, Owner{ OwnerType::Reserved, newStation.Id() });
 					}
 				}
 			}
 		}
 	}
 
-	set<TilePosition>& Map::stationDefenses(const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
+	set<TilePosition> Map::stationDefenses(const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
 	{
-		return stationDefenses(Broodwar->self(), here, mirrorHorizontal, mirrorVertical);
+		return stationDefenses(selfRace(), here, mirrorHorizontal, mirrorVertical);
 	}
-	set<TilePosition>& Map::stationDefenses(BWAPI::Player player, const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
+	set<TilePosition> Map::stationDefenses(BWAPI::Player player, const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
 	{
 		return stationDefenses(player->getRace(), here, mirrorHorizontal, mirrorVertical);
 	}
-	set<TilePosition>& Map::stationDefenses(BWAPI::Race race, const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
+	set<TilePosition> Map::stationDefenses(BWAPI::Race race, const TilePosition here, const bool mirrorHorizontal, const bool mirrorVertical)
 	{
-		returnValues.clear();
+		set<TilePosition> returnValues;
 		if (mirrorVertical)
 		{
 			if (mirrorHorizontal)
@@ -102,14 +113,20 @@ namespace BWEB
 		if (race == Races::Terran)
 			returnValues.insert(here + TilePosition(4, 1));
 
-		for (auto& tile : returnValues)
-			addOverlap(tile, 2, 2);
-
 		return returnValues;
 	}
 
+	const Station* Map::getStationById(const int id) const
+	{
+		if (busy(Subsystem::Stations))
+			return nullptr;
+		return findById(stations, id, [](const Station& station) { return station.Id(); });
+	}
+
 	const Station* Map::getClosestStation(TilePosition here) const
 	{
+		if (busy(Subsystem::Stations))
+			return nullptr;
 		auto distBest = DBL_MAX;
 		const Station* bestStation = nullptr;
 		for (auto& station : stations)
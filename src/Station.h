@@ -11,6 +11,7 @@ namespace BWEB
 		const BWEM::Base * base;
 		set<TilePosition> defenses;
 		Position resourceCentroid;
+		int id = -1;
 
 	public:
 		Station(Position, const set<TilePosition>&, const BWEM::Base*);
@@ -21,6 +22,10 @@ namespace BWEB
 		// Returns the set of defense locations associated with this base
 		const set<TilePosition>& DefenseLocations() const { return defenses; }
 
+		// Returns the id of this station
+		int Id() const { return id; }
+		void setId(int newId) { id = newId; }
+
 		// Returns the BWEM base associated with this BWEB base
 		const BWEM::Base * BWEMBase() const { return base; }
 	};
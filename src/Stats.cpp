@@ -0,0 +1,57 @@
+#include "Stats.h"
+
+namespace BWEB
+{
+	double TimerStats::percentileMs(const double percentile) const
+	{
+		if (calls == 0)
+			return 0.0;
+
+		const auto wanted = double(calls) * percentile / 100.0;
+		uint64_t seen = 0;
+		for (int i = 0; i < buckets; i++) {
+			seen += histogram[i];
+			if (double(seen) >= wanted)
+				return double(uint64_t(1) << (i + 1)) / 1e6;
+		}
+		return maxMs();
+	}
+
+	void Stats::record(const Timer timer, const uint64_t ns)
+	{
+		auto& t = timers[int(timer)];
+		t.calls.fetch_add(1, memory_order_relaxed);
+		t.totalNs.fetch_add(ns, memory_order_relaxed);
+
+		auto max = t.maxNs.load(memory_order_relaxed);
+		while (ns > max && !t.maxNs.compare_exchange_weak(max, ns, memory_order_relaxed)) {}
+
+		auto bucket = 0;
+		while (bucket < TimerStats::buckets - 1 && (ns >> (bucket + 1)) != 0)
+			bucket++;
+		t.histogram[bucket].fetch_add(1, memory_order_relaxed);
+	}
+
+	TimerStats Stats::get(const Timer timer) const
+	{
+		auto& t = timers[int(timer)];
+		TimerStats stats;
+		stats.calls = t.calls.load(memory_order_relaxed);
+		stats.totalNs = t.totalNs.load(memory_order_relaxed);
+		stats.maxNs = t.maxNs.load(memory_order_relaxed);
+		for (int i = 0; i < TimerStats::buckets; i++)
+			stats.histogram[i] = t.histogram[i].load(memory_order_relaxed);
+		return stats;
+	}
+
+	void Stats::reset()
+	{
+		for (auto& t : timers) {
+			t.calls = 0, t.totalNs = 0, t.maxNs = 0;
+			for (auto& bucket : t.histogram)
+				bucket = 0;
+		}
+		for (auto& counter : counters)
+			counter = 0;
+	}
+}
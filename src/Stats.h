@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace BWEB
+{
+	using namespace std;
+
+	// Calls BWEB keeps a latency histogram for
+	enum class Timer : unsigned char { OnStart, FindBlocks, CreateWall, FindPath, GetBuildPosition, GetDefBuildPosition, OverlapsBlocks, OverlapsStations, OverlapsWalls, OverlapsMining, OverlapsNeutrals, OverlapsAnything, Update, GetFlowField, Count };
+
+	// Search work BWEB counts: nodes expanded by the wall search and by path finding, first piece anchors the wall search kept, and wall search nodes expanded before each best wall was first found, summed over every Wall (Wall::getNodesToBest has them per Wall)
+	enum class Counter : unsigned char { WallNodes, PathNodes, WallAnchors, WallNodesToBest, Count };
+
+	// Latency of one call, bucket i counts calls that took between 2^i and 2^(i+1) nanoseconds
+	struct TimerStats
+	{
+		static const int buckets = 40;
+		uint64_t calls = 0, totalNs = 0, maxNs = 0;
+		uint64_t histogram[buckets] = {};
+
+		double meanMs() const { return calls ? double(totalNs) / double(calls) / 1e6 : 0.0; }
+		double maxMs() const { return double(maxNs) / 1e6; }
+
+		// Returns the upper edge of the bucket that holds the given percentile (0 to 100)
+		double percentileMs(double percentile) const;
+	};
+
+	// Thread safe counters, every record is dropped while disabled so instrumented calls only pay for one relaxed load
+	class Stats
+	{
+		struct AtomicTimer
+		{
+			atomic<uint64_t> calls, totalNs, maxNs;
+			atomic<uint64_t> histogram[TimerStats::buckets];
+		};
+
+		atomic<bool> enabled{ false };
+		AtomicTimer timers[int(Timer::Count)];
+		atomic<uint64_t> counters[int(Counter::Count)];
+
+	public:
+		Stats() { reset(); }
+
+		bool isEnabled() const { return enabled.load(memory_order_relaxed); }
+		void setEnabled(bool enable) { enabled.store(enable, memory_order_relaxed); }
+
+		void record(Timer, uint64_t ns);
+		void count(Counter counter, uint64_t amount)
+		{
+			if (isEnabled())
+				counters[int(counter)].fetch_add(amount, memory_order_relaxed);
+		}
+
+		TimerStats get(Timer) const;
+		uint64_t get(Counter counter) const { return counters[int(counter)].load(memory_order_relaxed); }
+		void reset();
+	};
+
+	// Records how long the enclosing scope took, the clock is only read while Stats are enabled
+	class ScopedTimer
+	{
+		Stats& stats;
+		Timer timer;
+		bool active;
+		chrono::steady_clock::time_point start;
+
+	public:
+		ScopedTimer(Stats& s, Timer t) : stats(s), timer(t), active(s.isEnabled())
+		{
+			if (active)
+				start = chrono::steady_clock::now();
+		}
+
+		~ScopedTimer()
+		{
+			if (active)
+				stats.record(timer, uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+	};
+}
@@ -0,0 +1,135 @@
+#include "Trace.h"
+
+#ifdef BWEB_TRACING
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace BWEB
+{
+	using namespace std;
+
+	namespace
+	{
+		struct Event
+		{
+			const char * name;
+			int frame;
+			long long start, duration;
+		};
+
+		// Every thread records into its own buffer, the file is only touched when a buffer fills up or the trace is closed
+		struct ThreadBuffer
+		{
+			mutex lock;
+			vector<Event> events;
+			int tid = 0;
+		};
+
+		const size_t bufferSize = 4096;
+		atomic<bool> tracing{ false };
+		atomic<int> nextTid{ 1 };
+		mutex registryLock, fileLock;
+		vector<shared_ptr<ThreadBuffer>> buffers;
+		FILE * traceFile = nullptr;
+		bool firstEvent = true;
+		const auto traceStart = chrono::steady_clock::now();
+
+		long long microseconds(const chrono::steady_clock::time_point time)
+		{
+			return chrono::duration_cast<chrono::microseconds>(time - traceStart).count();
+		}
+
+		ThreadBuffer& threadBuffer()
+		{
+			// Kept alive by the registry after the thread exits, so close still writes what it recorded
+			thread_local shared_ptr<ThreadBuffer> buffer;
+			if (!buffer) {
+				buffer = make_shared<ThreadBuffer>();
+				buffer->tid = nextTid++;
+				buffer->events.reserve(bufferSize);
+				lock_guard<mutex> lock(registryLock);
+				buffers.push_back(buffer);
+			}
+			return *buffer;
+		}
+
+		void write(const vector<Event>& events, const int tid)
+		{
+			lock_guard<mutex> lock(fileLock);
+			if (!traceFile)
+				return;
+			for (auto& event : events) {
+				fprintf(traceFile, "%s{\"name\":\"%s\",\"cat\":\"BWEB\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%d}}",
+					firstEvent ? "" : ",\n", event.name, tid, event.start, event.duration, event.frame);
+				firstEvent = false;
+			}
+		}
+
+		void flush(ThreadBuffer& buffer)
+		{
+			vector<Event> events;
+			{
+				lock_guard<mutex> lock(buffer.lock);
+				events.swap(buffer.events);
+				buffer.events.reserve(bufferSize);
+			}
+			write(events, buffer.tid);
+		}
+	}
+
+	bool Trace::open(const string& path)
+	{
+		close();
+		lock_guard<mutex> lock(fileLock);
+		traceFile = fopen(path.c_str(), "w");
+		firstEvent = true;
+		if (traceFile)
+			fputs("{\"traceEvents\":[\n", traceFile);
+		tracing = traceFile != nullptr;
+		return traceFile != nullptr;
+	}
+
+	void Trace::close()
+	{
+		tracing = false;
+		{
+			lock_guard<mutex> lock(registryLock);
+			for (auto& buffer : buffers)
+				flush(*buffer);
+		}
+
+		lock_guard<mutex> lock(fileLock);
+		if (!traceFile)
+			return;
+		fputs("\n]}\n", traceFile);
+		fclose(traceFile);
+		traceFile = nullptr;
+	}
+
+	TraceZone::~TraceZone()
+	{
+		if (!tracing.load(memory_order_relaxed))
+			return;
+
+		const auto end = chrono::steady_clock::now();
+		auto& buffer = threadBuffer();
+		bool full;
+		{
+			lock_guard<mutex> lock(buffer.lock);
+			buffer.events.push_back({ name, frame, microseconds(start), microseconds(end) - microseconds(start) });
+			full = buffer.events.size() >= bufferSize;
+		}
+		if (full)
+			flush(buffer);
+	}
+}
+#else
+namespace BWEB
+{
+	bool Trace::open(const std::string&) { return false; }
+	void Trace::close() {}
+}
+#endif
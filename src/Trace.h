@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+
+// Chrome trace events around BWEB's phases, load the file in chrome://tracing or Perfetto
+// Zones only exist when BWEB_TRACING is defined, otherwise every macro expands to nothing and its arguments are never evaluated
+#ifdef BWEB_TRACING
+#include <chrono>
+
+#define BWEB_TRACE_CONCAT_INNER(a, b) a##b
+#define BWEB_TRACE_CONCAT(a, b) BWEB_TRACE_CONCAT_INNER(a, b)
+#define BWEB_TRACE_ZONE(name, frame) BWEB::TraceZone BWEB_TRACE_CONCAT(bwebTraceZone, __LINE__)(name, frame)
+#else
+#define BWEB_TRACE_ZONE(name, frame) ((void)0)
+#endif
+
+namespace BWEB
+{
+	namespace Trace
+	{
+		// Starts writing zones to a trace file, returns false if it can't be opened or tracing is compiled out
+		bool open(const std::string& path);
+
+		// Finishes the file, zones recorded after this are dropped
+		void close();
+	}
+
+#ifdef BWEB_TRACING
+	// Records one complete event covering its own lifetime, tagged with the thread it ran on and the game frame
+	// Events go to a buffer of the thread that recorded them and reach the file when the buffer fills up or the trace is closed
+	class TraceZone
+	{
+		const char * name;
+		int frame;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		TraceZone(const char * n, int f) : name(n), frame(f), start(std::chrono::steady_clock::now()) {}
+		~TraceZone();
+
+		TraceZone(const TraceZone&) = delete;
+		TraceZone& operator=(const TraceZone&) = delete;
+	};
+#endif
+}
@@ -1,5 +1,6 @@
 #include "Wall.h"
-#include <tuple>
+#include "Trace.h"
+#include "WallAnchors.h"
 
 namespace BWEB
 {
@@ -12,12 +13,47 @@ namespace BWEB
 
 	void Map::createWall(vector<UnitType>& buildings, const BWEM::Area * area, const BWEM::ChokePoint * choke, const UnitType tight, const vector<UnitType>& defenses, const bool reservePath, const bool requireTight)
 	{
-		if (!area || !choke || buildings.empty())
+		if (deferWhileBusy([=]() mutable { createWall(buildings, area, choke, tight, defenses, reservePath, requireTight); }))
+			return;
+		BWEB_TRACE_ZONE("createWall", frame());
+		ScopedTimer timer(stats, Timer::CreateWall);
+
+		// A queued Wall that is part way through its search shares our search state, let it finish first
+		if (wallSearching)
+			scheduler.finish();
+
+		if (!beginWall(buildings, area, choke, tight, defenses, reservePath, requireTight))
 			return;
+		while (!stepWall()) {}
+		finishWall();
+	}
+
+	void Map::queueWall(const vector<UnitType>& buildings, const BWEM::Area * area, const BWEM::ChokePoint * choke, const UnitType tight, const vector<UnitType>& defenses, const bool reservePath, const bool requireTight, const Priority priority)
+	{
+		if (deferWhileBusy([=]() { queueWall(buildings, area, choke, tight, defenses, reservePath, requireTight, priority); }))
+			return;
+		scheduler.push(priority, [=, started = false]() mutable {
+			if (!started) {
+				started = true;
+				return !beginWall(buildings, area, choke, tight, defenses, reservePath, requireTight);
+			}
+			if (!stepWall())
+				return false;
+			finishWall();
+			return true;
+		});
+	}
+
+	bool Map::beginWall(const vector<UnitType>& buildings, const BWEM::Area * area, const BWEM::ChokePoint * choke, const UnitType tight, const vector<UnitType>& defenses, const bool reservePath, const bool requireTight)
+	{
+		if (!area || !choke || buildings.empty())
+			return false;
 
 		// I got sick of passing the parameters everywhere, sue me
 		this->buildings = buildings, this->area = area, this->choke = choke, this->tight = tight, this->reservePath = reservePath;
 		this->requireTight = requireTight;
+		wallDefenses = defenses;
+		bestWall.clear(), bestWallScore = 0.0;
 
 		double distBest = DBL_MAX;
 		for (auto& base : this->area->Bases()) {
@@ -28,30 +64,124 @@ namespace BWEB
 
 		chokeWidth = 10;// max(6, int(choke->Pos(choke->end1).getDistance(choke->Pos(choke->end2)) / 8));
 
-		// Create a new wall object
-		Wall newWall(area, choke);
+		// The id is taken up front so Walls keep the order they were asked for
+		wallId = nextId++;
 
 		// Setup pathing parameters
 		resetStartEndTiles();
 		setStartTile();
 		setEndTile();
 
-		// Iterate pieces, try to find best location
-		if (iteratePieces()) {
+		setupPieces();
+		findWallAnchors();
+
+		// Every ordering of the pieces in front of the pylons, tried in the order stepWall picks
+		wallOrders.clear(), bestOrder.clear();
+		for (auto& history : wallHistory)
+			fill(history.second.begin(), history.second.end(), 0.0);
+		auto order = this->buildings;
+		do {
+			wallOrders.push_back(order);
+		} while (next_permutation(order.begin(), find(order.begin(), order.end(), UnitTypes::Protoss_Pylon)));
+		wallChokeTile = TilePosition(choke->Center());
+		wallNodes = 0, bestWallNode = 0;
+
+		wallSearching = true;
+		return true;
+	}
+
+	bool Map::stepWall()
+	{
+		BWEB_TRACE_ZONE("createWall permutation", frame());
+		// Every ordering of the pieces is one step, the ordering most like the one that found the best wall so far goes next
+		if (wallOrders.empty())
+			return true;
+
+		auto next = wallOrders.begin();
+		if (!bestOrder.empty()) {
+			auto matchBest = -1;
+			for (auto it = wallOrders.begin(); it != wallOrders.end(); ++it) {
+				auto match = 0;
+				for (size_t i = 0; i < it->size(); i++)
+					match += (*it)[i] == bestOrder[i];
+				if (match > matchBest)
+					matchBest = match, next = it;
+			}
+		}
+		buildings = *next;
+		wallOrders.erase(next);
+
+		currentWall.clear();
+		typeIterator = buildings.begin();
+		checkPiece(wallStart);
+		return wallOrders.empty();
+	}
+
+	void Map::orderCandidates(const UnitType type, vector<TilePosition>& candidates)
+	{
+		// Killer placements from the best wall so far come first, then placements that were part of good walls, then tiles close to the choke, then the raster order the search used before
+		const auto& history = historyOf(type);
+		wallRanked.clear();
+		for (auto& t : candidates) {
+			auto killer = false;
+			for (auto& placement : bestWall)
+				killer |= placement.first == t && placement.second == type;
+			const auto inside = t.x >= 0 && t.y >= 0 && t.x < wallHistoryWidth && size_t(t.x + t.y * wallHistoryWidth) < history.size();
+			wallRanked.push_back({ killer, inside ? history[t.x + t.y * wallHistoryWidth] : 0.0, t.getDistance(wallChokeTile), t });
+		}
+		sort(wallRanked.begin(), wallRanked.end(), [](const RankedTile& l, const RankedTile& r) {
+			if (l.killer != r.killer)
+				return l.killer;
+			if (l.history != r.history)
+				return l.history > r.history;
+			if (l.distance != r.distance)
+				return l.distance < r.distance;
+			return l.tile.x != r.tile.x ? l.tile.x < r.tile.x : l.tile.y < r.tile.y;
+		});
+		for (size_t i = 0; i < wallRanked.size(); i++)
+			candidates[i] = wallRanked[i].tile;
+	}
+
+	vector<double>& Map::historyOf(const UnitType type)
+	{
+		// One score per tile of the map, sized the first time a type is seen and kept between walls
+		wallHistoryWidth = game->mapWidth();
+		auto& history = wallHistory[type];
+		if (history.size() != size_t(game->mapWidth() * game->mapHeight()))
+			history.assign(game->mapWidth() * game->mapHeight(), 0.0);
+		return history;
+	}
+
+	void Map::finishWall()
+	{
+		wallSearching = false;
+		if (!bestWall.empty())
+			stats.count(Counter::WallNodesToBest, bestWallNode);
+
+		// Create a new wall object
+		Wall newWall(area, choke);
+		newWall.setId(wallId);
+		newWall.setSearchNodes(wallNodes, bestWallNode);
+		const auto& defenses = wallDefenses;
+
+		// Use the best location found
+		if (!bestWall.empty()) {
 			for (auto& placement : bestWall) {
 				newWall.insertSegment(placement.first, placement.second);
-				addOverlap(placement.first, placement.second.tileWidth(), placement.second.tileHeight());
+				addOverlap(placement.first, placement.second.tileWidth(), placement.second.tileHeight(), Owner{ OwnerType::Wall, newWall.getId() });
 			}
 
 			currentWall = bestWall;
 			findCurrentHole();
 
-			if (requireTight && currentHole.isValid())
+			if (requireTight && currentHole.isValid()) {
+				publish();
 				return;
+			}
 
 			for (auto& tile : currentPath) {
 				if (reservePath)
-					reserveGrid[tile.x][tile.y] = 1;
+					reserveGrid[tile.x][tile.y] = 1, reserveChanged = true;
 
 				if (!newWall.getDoor().isValid()) {
 					TilePosition left = tile + TilePosition(-1, 0);
@@ -82,15 +212,24 @@ namespace BWEB
 
 			// Push wall into the vector
 			walls.push_back(newWall);
+			wallsChanged = true;
+			publish();
 		}
 	}
 
-	bool Map::iteratePieces()
+	void Map::setupPieces()
 	{
+		// Every type gets a visited grid up front, the search looks them up by type
+		for (auto& type : buildings) {
+			auto& grid = visited[type].location;
+			if (grid.width() != game->mapWidth() || grid.height() != game->mapHeight())
+				grid.resize(game->mapWidth(), game->mapHeight());
+		}
+
 		TilePosition start = static_cast<TilePosition>(choke->Center());
 
 		int i = 0;
-		while (!Broodwar->isBuildable(start)) {
+		while (!game->isBuildable(start)) {
 
 			if (i == 10)
 				break;
@@ -120,13 +259,29 @@ namespace BWEB
 		else
 			sort(buildings.begin(), buildings.end());
 
-		do {
-			currentWall.clear();
-			typeIterator = buildings.begin();
-			checkPiece(start);
-		} while (next_permutation(buildings.begin(), find(buildings.begin(), buildings.end(), UnitTypes::Protoss_Pylon)));
+		wallStart = start;
+	}
 
-		return !bestWall.empty();
+	void Map::findWallAnchors()
+	{
+		// The first piece has to be tight against the terrain and touch a choke end, directly or through one more piece
+		wallAnchors.clear();
+		auto reach = 1;
+		for (auto& type : buildings)
+			reach = max(reach, max(type.tileWidth(), type.tileHeight()));
+		const vector<TilePosition> chokeEnds = { TilePosition(choke->Pos(choke->end1)), TilePosition(choke->Pos(choke->end2)) };
+
+		// Nothing is placed yet, so every test here only depends on the terrain and what BWEB already laid out
+		currentWall.clear();
+		for (auto it = buildings.begin(); it != buildings.end(); ++it) {
+			const auto type = *it;
+			if (type == UnitTypes::Protoss_Pylon || wallAnchors.find(type) != wallAnchors.end())
+				continue;
+
+			typeIterator = it;
+			const auto& anchors = wallAnchors[type] = findAnchors(wallStart, chokeWidth, type.tileSize(), chokeEnds, reach, [&](const TilePosition t) { return testPiece(t) && isWallTight(type, t); });
+			stats.count(Counter::WallAnchors, anchors.size());
+		}
 	}
 
 	bool Map::checkPiece(const TilePosition start)
@@ -148,6 +303,9 @@ namespace BWEB
 			const auto parentLeft = (parentSize.x * 16) - parentType.dimensionLeft();
 			const auto currentRight = (currentSize.x * 16) - (*typeIterator).dimensionRight() - 1;
 
+			// Tiles around the parent are gathered first so the most promising ones can be tried first
+			vector<TilePosition> candidates;
+
 			// Left edge and right edge
 			if (parentRight + currentLeft < tightnessFactor || parentLeft + currentRight < tightnessFactor) {
 				const auto xLeft = start.x - currentSize.x;
@@ -156,14 +314,10 @@ namespace BWEB
 					const TilePosition left(xLeft, y);
 					const TilePosition right(xRight, y);
 
-					if (left.isValid() && visited[currentType].location[left.x][left.y] != 2) {
-						if (parentLeft + currentRight < tightnessFactor && testPiece(left))
-							placePiece(left);
-					}
-					if (right.isValid() && visited[currentType].location[right.x][right.y] != 2) {
-						if (parentRight + currentLeft < tightnessFactor && testPiece(right))
-							placePiece(right);
-					}
+					if (left.isValid() && parentLeft + currentRight < tightnessFactor)
+						candidates.push_back(left);
+					if (right.isValid() && parentRight + currentLeft < tightnessFactor)
+						candidates.push_back(right);
 				}
 			}
 
@@ -179,30 +333,44 @@ namespace BWEB
 				for (auto x = 1 + start.x - currentSize.x; x < start.x + parentSize.x; x++) {
 					const TilePosition top(x, yTop);
 					const TilePosition bot(x, yBottom);
-					if (top.isValid() && visited[currentType].location[top.x][top.y] != 2) {
-						if (parentTop + currentBottom < tightnessFactor && testPiece(top))
-							placePiece(top);
-					}
-					if (bot.isValid() && visited[currentType].location[bot.x][bot.y] != 2) {
-						if (parentBottom + currentTop < tightnessFactor && testPiece(bot))
-							placePiece(bot);
-					}
+					if (top.isValid() && parentTop + currentBottom < tightnessFactor)
+						candidates.push_back(top);
+					if (bot.isValid() && parentBottom + currentTop < tightnessFactor)
+						candidates.push_back(bot);
 				}
 			}
+
+			orderCandidates(currentType, candidates);
+			for (auto& t : candidates) {
+				if (visited[currentType].location[t.x][t.y] != 2 && testPiece(t))
+					placePiece(t);
+			}
 		}
 
-		// Otherwise we need to start the choke center
-		else {
-			for (auto x = start.x - chokeWidth; x < start.x + chokeWidth; x++) {
-				for (auto y = start.y - chokeWidth; y < start.y + chokeWidth; y++) {
+		// Pylons only need to power the wall, try every tile that powers the parent and isn't known to be impossible, isPoweringWall checks the rest of the wall
+		else if (currentType == UnitTypes::Protoss_Pylon) {
+			const auto powerMin = parentType != UnitTypes::None ? start - TilePosition(6, 4) : start - TilePosition(chokeWidth, chokeWidth);
+			const auto powerMax = parentType != UnitTypes::None ? start + TilePosition(9, 6) : start + TilePosition(chokeWidth, chokeWidth);
+			for (auto x = powerMin.x; x < powerMax.x; x++) {
+				for (auto y = powerMin.y; y < powerMax.y; y++) {
 					const TilePosition t(x, y);
 					parentSame = false, currentSame = false;
-					if (t.isValid() && testPiece(t) && (isWallTight((*typeIterator), t) || currentType == UnitTypes::Protoss_Pylon))
+					if (t.isValid() && visited[currentType].location[x][y] != 2 && testPiece(t))
 						placePiece(t);
-
 				}
 			}
 		}
+
+		// Otherwise we need to start at the choke, from an anchor found when the Wall was started
+		else {
+			auto& anchors = wallAnchors[currentType];
+			orderCandidates(currentType, anchors);
+			for (auto& t : anchors) {
+				parentSame = false, currentSame = false;
+				if (testPiece(t))
+					placePiece(t);
+			}
+		}
 		return true;
 	}
 
@@ -245,6 +413,9 @@ namespace BWEB
 
 	bool Map::placePiece(const TilePosition t)
 	{
+		stats.count(Counter::WallNodes, 1);
+		wallNodes++;
+
 		// If we haven't tried to place one here, set visited
 		if (!currentSame)
 			visited[(*typeIterator)].location[t.x][t.y] = 1;
@@ -280,6 +451,16 @@ namespace BWEB
 				const auto score = currentPathSize / dist;
 				if (score > bestWallScore && (!reservePath || currentHole != TilePositions::None)) {
 					bestWall = currentWall, bestWallScore = score;
+					bestOrder = buildings, bestWallNode = wallNodes;
+				}
+
+				// Every placement of a finished wall earns its score, so placements of good walls are tried first from now on,
+				// capped so a placement that was in many walls ties with the rest instead of growing without bound
+				if (!reservePath || currentHole != TilePositions::None) {
+					for (auto& piece : currentWall) {
+						auto& history = historyOf(piece.second)[piece.first.x + piece.first.y * wallHistoryWidth];
+						history = min(history + score, wallHistoryCap);
+					}
 				}
 			}
 		}
@@ -296,6 +477,7 @@ namespace BWEB
 
 	void Map::findCurrentHole(bool ignoreOverlap)
 	{
+		BWEB_TRACE_ZONE("findCurrentHole", frame());
 		if (overlapsCurrentWall(startTile) != UnitTypes::None || !isWalkable(startTile) || !isWalkable(endTile))
 			setStartTile();
 		if (overlapsCurrentWall(endTile) != UnitTypes::None || !isWalkable(startTile) || !isWalkable(endTile))
@@ -303,7 +485,7 @@ namespace BWEB
 
 		// Reset hole and get a new path
 		currentHole = TilePositions::None;
-		currentPath = findPath(mapBWEM, *this, startTile, endTile, ignoreOverlap);
+		currentPath = findWallPath(startTile, endTile, ignoreOverlap);
 
 		// Quick check to see if the path contains our end point
 		if (find(currentPath.begin(), currentPath.end(), endTile) == currentPath.end()) {
@@ -325,7 +507,59 @@ namespace BWEB
 		resetStartEndTiles();
 	}
 
-	UnitType Map::overlapsCurrentWall(const TilePosition here, const int width, const int height)
+	vector<TilePosition> Map::findWallPath(const TilePosition source, const TilePosition target, const bool ignoreOverlap)
+	{
+		BWEB_TRACE_ZONE("findWallPath", frame());
+		ScopedTimer timer(stats, Timer::FindPath);
+		const auto width = game->mapWidth(), height = game->mapHeight();
+		if (width > BitBoard::maxSize || height > BitBoard::maxSize)
+			return findPath(mapBWEM, *this, source, target, ignoreOverlap);
+
+		if (!walkableBoardReady) {
+			walkableBoard.clear();
+			for (auto x = 0; x < width; x++) {
+				for (auto y = 0; y < height; y++) {
+					if (isWalkable(TilePosition(x, y)))
+						walkableBoard.set(x, y);
+				}
+			}
+			walkableBoardReady = true;
+		}
+		if (overlapBoardVersion != overlapVersion) {
+			overlapBoard.clear();
+			for (auto x = 0; x < width; x++) {
+				for (auto y = 0; y < height; y++) {
+					if (overlapGrid[x][y] > 0)
+						overlapBoard.set(x, y);
+				}
+			}
+			overlapBoardVersion = overlapVersion;
+		}
+
+		// Same tiles findPath would walk: walkable, not overlapped unless ignored and not under a piece of the wall being searched
+		for (auto y = 0; y < height; y++) {
+			const auto walkable = walkableBoard.row(y);
+			const auto overlap = overlapBoard.row(y);
+			auto passable = passableBoard.row(y);
+			for (int w = 0; w < BitBoard::rowWords; w++)
+				passable[w] = ignoreOverlap ? walkable[w] : walkable[w] & ~overlap[w];
+		}
+		for (auto& piece : currentWall) {
+			for (auto x = piece.first.x; x < piece.first.x + piece.second.tileWidth(); x++) {
+				for (auto y = piece.first.y; y < piece.first.y + piece.second.tileHeight(); y++) {
+					if (x >= 0 && y >= 0 && x < width && y < height)
+						passableBoard.reset(x, y);
+				}
+			}
+		}
+
+		// The hole and the score depend on which shortest path it is, so it has to be the one findPath picks
+		auto path = shortestPath(passableBoard, height, source, target, wallPathSearch, wallPathBack);
+		stats.count(Counter::PathNodes, wallPathSearch.getReachedCount() + wallPathBack.getReachedCount());
+		return path;
+	}
+
+	UnitType Map::overlapsCurrentWall(const TilePosition here, const int width, const int height) const
 	{
 		for (auto x = here.x; x < here.x + width; x++) {
 			for (auto y = here.y; y < here.y + height; y++) {
@@ -367,14 +601,17 @@ namespace BWEB
 		}
 
 		if (tileBest.isValid()) {
+			wallsChanged = true;
 			currentWall[tileBest] = building;
 			wall.insertDefense(tileBest);
-			addOverlap(tileBest, 2, 2);
+			insertSlot(defenseSlots, tileBest);
+			addOverlap(tileBest, 2, 2, Owner{ OwnerType::WallDefense, wall.getId() });
 		}
 
 		for (auto& defense : wall.getDefenses()) {
-			addOverlap(defense, building.tileWidth(), building.tileHeight());
+			addOverlap(defense, building.tileWidth(), building.tileHeight(), Owner{ OwnerType::WallDefense, wall.getId() });
 		}
+		publish();
 	}
 
 	void Map::addWallDefenses(const vector<UnitType>& types, Wall& wall)
@@ -423,16 +660,20 @@ namespace BWEB
 
 	void Wall::insertSegment(const TilePosition here, UnitType building)
 	{
-		if (building.tileWidth() >= 4)
-			large.insert(here);
-		else if (building.tileWidth() >= 3)
-			medium.insert(here);
-		else
-			small.insert(here);
+		slots.insert(here, footprintOf(building));
+	}
+
+	const Wall * Map::getWallById(const int id) const
+	{
+		if (busy(Subsystem::Walls))
+			return nullptr;
+		return findById(walls, id, [](const Wall& wall) { return wall.getId(); });
 	}
 
 	const Wall * Map::getClosestWall(TilePosition here) const
 	{
+		if (busy(Subsystem::Walls))
+			return nullptr;
 		double distBest = DBL_MAX;
 		const Wall * bestWall = nullptr;
 		for (auto& wall : walls) {
@@ -447,7 +688,7 @@ namespace BWEB
 
 	Wall* Map::getWall(const BWEM::Area * area, const BWEM::ChokePoint * choke)
 	{
-		if (!area && !choke)
+		if ((!area && !choke) || busy(Subsystem::Walls))
 			return nullptr;
 
 		for (auto& wall : walls) {
@@ -489,7 +730,7 @@ namespace BWEB
 			const auto x = right.x;
 			WalkPosition w(x, y);
 			TilePosition t(w);
-			if (R && (!w.isValid() || !Broodwar->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
+			if (R && (!w.isValid() || !game->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
 				return true;
 			if (!requireTight && !isWalkable(t))
 				return true;
@@ -499,7 +740,7 @@ namespace BWEB
 			const auto x = left.x;
 			WalkPosition w(x, y);
 			TilePosition t(w);
-			if (L && (!w.isValid() || !Broodwar->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
+			if (L && (!w.isValid() || !game->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
 				return true;
 			if (!requireTight && !isWalkable(t))
 				return true;
@@ -509,7 +750,7 @@ namespace BWEB
 			const auto y = top.y;
 			WalkPosition w(x, y);
 			TilePosition t(w);
-			if (T && (!w.isValid() || !Broodwar->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
+			if (T && (!w.isValid() || !game->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
 				return true;
 			if (!requireTight && !isWalkable(t))
 				return true;
@@ -519,7 +760,7 @@ namespace BWEB
 			const auto y = bottom.y;
 			WalkPosition w(x, y);
 			TilePosition t(w);
-			if (B && (!w.isValid() || !Broodwar->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
+			if (B && (!w.isValid() || !game->isWalkable(w) /*|| overlapGrid[t.x][t.y] > 0*/))
 				return true;
 			if (!requireTight && !isWalkable(t))
 				return true;
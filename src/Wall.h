@@ -10,22 +10,32 @@ namespace BWEB
 	{
 		TilePosition door;
 		Position centroid;
-		set<TilePosition> defenses, small, medium, large;
+		SlotBuffer slots;
 		const BWEM::Area * area;
 		const BWEM::ChokePoint * choke;
+		uint64_t nodesSearched = 0, nodesToBest = 0;
 		
 	public:
 		Wall(const BWEM::Area *, const BWEM::ChokePoint *);
-		void insertDefense(TilePosition here) { defenses.insert(here); }
+		void insertDefense(TilePosition here) { slots.insert(here, Footprint::Defense); }
 		void setWallDoor(TilePosition here) { door = here; }
 		void insertSegment(TilePosition, UnitType);
+		void insertSegment(TilePosition here, Footprint footprint) { slots.insert(here, footprint); }
 		void setCentroid(Position here) { centroid = here; }
+		void setSearchNodes(uint64_t searched, uint64_t toBest) { nodesSearched = searched, nodesToBest = toBest; }
 
 		const BWEM::ChokePoint * getChokePoint() const { return choke; }
 		const BWEM::Area * getArea() const { return area; }
+
+		// Returns the id of this Wall
+		int getId() const { return slots.getOwner(); }
+		void setId(int id) { slots.setOwner(id); }
+
+		// Returns every piece and defense of this Wall, grouped by footprint
+		const SlotBuffer& getSlots() const { return slots; }
 		
 		// Returns the defense locations associated with this Wall
-		set<TilePosition> getDefenses() const { return defenses; }
+		TileRange getDefenses() const { return slots.of(Footprint::Defense); }
 
 		// Returns the TilePosition belonging to the position where a melee unit should stand to fill the gap of the wall
 		TilePosition getDoor() const { return door; }
@@ -34,12 +44,16 @@ namespace BWEB
 		Position getCentroid() const { return centroid; }
 
 		// Returns the TilePosition belonging to large UnitType buildings
-		set<TilePosition> largeTiles() const { return large; }
+		TileRange largeTiles() const { return slots.of(Footprint::Large); }
 
 		// Returns the TilePosition belonging to medium UnitType buildings
-		set<TilePosition> mediumTiles() const { return medium; }
+		TileRange mediumTiles() const { return slots.of(Footprint::Medium); }
 
 		// Returns the TilePosition belonging to small UnitType buildings
-		set<TilePosition> smallTiles() const { return small; }
+		TileRange smallTiles() const { return slots.of(Footprint::Small); }
+
+		// Returns how many nodes the search for this Wall expanded in total and before it first found this placement, 0 for Walls loaded from a layout file
+		uint64_t getNodesSearched() const { return nodesSearched; }
+		uint64_t getNodesToBest() const { return nodesToBest; }
 	};	
 }
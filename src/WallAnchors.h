@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <BWAPI.h>
+
+namespace BWEB
+{
+	using namespace BWAPI;
+	using namespace std;
+
+	// Tiles between the footprint of a piece at here and a tile, 0 when the piece covers it and 1 when the piece is right next to it
+	inline int tileGap(const TilePosition here, const TilePosition size, const TilePosition tile)
+	{
+		const auto gapX = max({ 0, here.x - tile.x, tile.x - (here.x + size.x - 1) });
+		const auto gapY = max({ 0, here.y - tile.y, tile.y - (here.y + size.y - 1) });
+		return max(gapX, gapY);
+	}
+
+	// Tiles the first piece of a Wall starts from: the square the search always scanned around the start tile, in the same order,
+	// kept where the piece touches a choke end or a piece of up to reach tiles right next to it could, and the root test passes
+	template <class RootTest>
+	vector<TilePosition> findAnchors(const TilePosition start, const int radius, const TilePosition size, const vector<TilePosition>& chokeEnds, const int reach, RootTest rootTest)
+	{
+		vector<TilePosition> anchors;
+		for (auto x = start.x - radius; x < start.x + radius; x++) {
+			for (auto y = start.y - radius; y < start.y + radius; y++) {
+				const TilePosition t(x, y);
+				const auto nearEnd = any_of(chokeEnds.begin(), chokeEnds.end(), [&](const TilePosition end) { return tileGap(t, size, end) <= reach + 1; });
+				if (nearEnd && t.isValid() && rootTest(t))
+					anchors.push_back(t);
+			}
+		}
+		return anchors;
+	}
+}
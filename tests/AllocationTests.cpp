@@ -0,0 +1,123 @@
+// Standalone checks that the layout accessors hand out views instead of copies, they need the BWAPI and BWEM headers but nothing from them is linked
+// g++ -std=c++17 -Isrc -I<BWAPI include> -I<BWEM include> tests/AllocationTests.cpp -o AllocationTests && ./AllocationTests
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "Block.h"
+
+namespace
+{
+	std::size_t allocations = 0;
+}
+
+// Every allocation in this program goes through here, the checks compare the count before and after a query
+void * operator new(std::size_t size)
+{
+	allocations++;
+	if (const auto memory = malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+void operator delete(void * memory) noexcept { free(memory); }
+void operator delete(void * memory, std::size_t) noexcept { free(memory); }
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	template <class Query>
+	size_t allocationsIn(Query query)
+	{
+		const auto before = allocations;
+		query();
+		return allocations - before;
+	}
+
+	Block makeBlock(const int id)
+	{
+		Block block;
+		block.setId(id);
+		block.insertLarge(TilePosition(0, 0));
+		block.insertSmall(TilePosition(4, 0));
+		block.insertSmall(TilePosition(4, 2));
+		block.insertMedium(TilePosition(0, 3));
+		return block;
+	}
+
+	void counterSeesAllocations()
+	{
+		CHECK(allocationsIn([]() { vector<int> copy(4); }) > 0);
+	}
+
+	void blockAccessorsDontAllocate()
+	{
+		const auto block = makeBlock(1);
+		size_t small = 0, medium = 0, large = 0, all = 0;
+		CHECK(allocationsIn([&]() {
+			for (auto& tile : block.SmallTiles()) small += tile.x >= 0;
+			for (auto& tile : block.MediumTiles()) medium += tile.x >= 0;
+			for (auto& tile : block.LargeTiles()) large += tile.x >= 0;
+			for (auto& tile : block.Slots().all()) all += tile.x >= 0;
+		}) == 0);
+		CHECK(small == 2 && medium == 1 && large == 1 && all == 4);
+	}
+
+	void defenseSlotsDontAllocate()
+	{
+		SlotBuffer slots;
+		slots.insert(TilePosition(2, 2), Footprint::Large);
+		slots.insert(TilePosition(8, 2), Footprint::Defense);
+		slots.insert(TilePosition(8, 4), Footprint::Defense);
+		TileRange defenses;
+		CHECK(allocationsIn([&]() { defenses = slots.of(Footprint::Defense); }) == 0);
+		CHECK(defenses.size() == 2);
+		CHECK(slots.of(Footprint::Medium).empty());
+	}
+
+	void collectionsAndIdLookupsDontAllocate()
+	{
+		vector<Block> blocks;
+		for (auto id : { 2, 4, 7 })
+			blocks.push_back(makeBlock(id));
+		const auto& layout = blocks;
+
+		const Block * found = nullptr;
+		const Block * missing = nullptr;
+		CHECK(allocationsIn([&]() {
+			const auto& view = layout;
+			found = findById(view, 4, [](const Block& block) { return block.Id(); });
+			missing = findById(view, 5, [](const Block& block) { return block.Id(); });
+		}) == 0);
+		CHECK(found && found->Id() == 4);
+		CHECK(!missing);
+	}
+
+	void closestSlotDoesntAllocate()
+	{
+		SlotIndex index(2, 2);
+		for (auto x = 0; x < 40; x += 4) {
+			for (auto y = 0; y < 40; y += 4)
+				index.free.insert(TilePosition(x, y));
+		}
+		auto best = TilePositions::Invalid;
+		CHECK(allocationsIn([&]() { best = closestSlot(index, TilePosition(21, 18), [](const TilePosition tile) { return tile.y != 20; }); }) == 0);
+		CHECK(best == TilePosition(20, 16));
+	}
+}
+
+int main()
+{
+	counterSeesAllocations();
+	blockAccessorsDontAllocate();
+	defenseSlotsDontAllocate();
+	collectionsAndIdLookupsDontAllocate();
+	closestSlotDoesntAllocate();
+
+	if (failures == 0)
+		printf("All allocation checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Standalone checks of Connectivity over the layered occupancy grids, they need the BWAPI headers and src/Connectivity.cpp
+// g++ -std=c++17 -Isrc -I<BWAPI include> tests/ConnectivityTests.cpp src/Connectivity.cpp -o ConnectivityTests && ./ConnectivityTests
+#include <cstdio>
+#include "Connectivity.h"
+#include "Owner.h"
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	// Two corridors between a left and a right column, everything else is rock
+	//   ............
+	//   .##########.
+	//   .##########.
+	//   ............
+	struct Corridors
+	{
+		static const int width = 12, height = 4;
+		Grid<Owner> owners;
+		Grid<LayerMask> layers;
+		Connectivity connectivity;
+		vector<TilePosition> keys = { TilePosition(0, 1), TilePosition(width - 1, 1) };
+
+		Corridors()
+		{
+			owners.resize(width, height);
+			layers.resize(width, height);
+		}
+
+		bool open(const TilePosition t) const
+		{
+			const auto rock = t.x > 0 && t.x < width - 1 && (t.y == 1 || t.y == 2);
+			return !rock && (layers[t.x][t.y] & solidLayers) == 0;
+		}
+
+		void build()
+		{
+			connectivity.build(width, height, [&](const TilePosition t) { return open(t); });
+		}
+	};
+
+	void neutralBlocksCorridor()
+	{
+		Corridors map;
+		map.build();
+		CHECK(map.connectivity.connected(map.keys[0], map.keys[1]));
+		CHECK(map.connectivity.keepsConnected(TilePosition(5, 3), 1, 1, map.keys));
+
+		// With the top corridor blocked by a neutral, closing the bottom one cuts the keys apart
+		addOwner(map.owners, map.layers, 5, 0, Owner{ OwnerType::Neutral, 3 });
+		map.connectivity.update(TilePosition(5, 0), 1, 1, [&](const TilePosition t) { return map.open(t); });
+		CHECK(map.connectivity.label(TilePosition(5, 0)) == 0);
+		CHECK(map.connectivity.connected(map.keys[0], map.keys[1]));
+		CHECK(!map.connectivity.keepsConnected(TilePosition(5, 3), 1, 1, map.keys));
+
+		// Same answer when the neutral was there before the labels were built
+		map.build();
+		CHECK(!map.connectivity.keepsConnected(TilePosition(5, 3), 1, 1, map.keys));
+	}
+
+	void miningDoesNotBlockCorridor()
+	{
+		Corridors map;
+		addOwner(map.owners, map.layers, 5, 0, Owner{ OwnerType::Mining, 0 });
+		map.build();
+		CHECK(map.connectivity.label(TilePosition(5, 0)) > 0);
+		CHECK(map.connectivity.keepsConnected(TilePosition(5, 3), 1, 1, map.keys));
+	}
+}
+
+int main()
+{
+	neutralBlocksCorridor();
+	miningDoesNotBlockCorridor();
+
+	if (failures == 0)
+		printf("All connectivity checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
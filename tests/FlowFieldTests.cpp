@@ -0,0 +1,102 @@
+// Standalone checks that repairing a FlowField gives the same field as building it again, they need the BWAPI headers and src/FlowField.cpp
+// g++ -std=c++17 -Isrc -I<BWAPI include> tests/FlowFieldTests.cpp src/FlowField.cpp -o FlowFieldTests && ./FlowFieldTests
+#include <cstdio>
+#include <random>
+#include "FlowField.h"
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	struct Field
+	{
+		static constexpr int width = 32, height = 32;
+		vector<vector<bool>> closed = vector<vector<bool>>(width, vector<bool>(height, false));
+		vector<TilePosition> goals = { TilePosition(2, 2), TilePosition(21, 27) };
+		function<bool(TilePosition)> open = [this](const TilePosition t) { return !closed[t.x][t.y]; };
+	};
+
+	// Every tile costs the same as in a field built from scratch, and its path walks down to a goal one step cost at a time
+	bool matchesRebuild(const Field& map, const FlowField& repaired)
+	{
+		FlowField rebuilt;
+		rebuilt.build(Field::width, Field::height, map.goals, map.open);
+		for (auto x = 0; x < Field::width; x++) {
+			for (auto y = 0; y < Field::height; y++) {
+				const TilePosition t(x, y);
+				if (repaired.getCost(t) != rebuilt.getCost(t))
+					return false;
+
+				const auto path = repaired.getPath(t);
+				if (path.empty())
+					continue;
+				if (find(map.goals.begin(), map.goals.end(), path.back()) == map.goals.end())
+					return false;
+				for (size_t i = 1; i < path.size(); i++) {
+					const auto diagonal = path[i].x != path[i - 1].x && path[i].y != path[i - 1].y;
+					if (repaired.getCost(path[i - 1]) != repaired.getCost(path[i]) + (diagonal ? 14 : 10))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void repairMatchesRebuild()
+	{
+		// Rectangles open and close at random, the field is repaired after some of them and compared to a fresh build
+		mt19937 random(7);
+		Field map;
+		FlowField field;
+		field.build(Field::width, Field::height, map.goals, map.open);
+
+		auto compared = 0, mismatches = 0;
+		for (auto edit = 0; edit < 4000; edit++) {
+			const TilePosition here(int(random() % Field::width), int(random() % Field::height));
+			const auto w = 1 + int(random() % 4), h = 1 + int(random() % 4);
+			const auto close = random() % 3 != 0;
+			for (auto x = here.x; x < min(Field::width, here.x + w); x++) {
+				for (auto y = here.y; y < min(Field::height, here.y + h); y++)
+					map.closed[x][y] = close;
+			}
+			field.invalidate(here, w, h);
+
+			if (random() % 2 == 0) {
+				field.repair(map.open);
+				CHECK(!field.isDirty());
+				mismatches += !matchesRebuild(map, field);
+				compared++;
+			}
+		}
+		CHECK(compared > 1000);
+		CHECK(mismatches == 0);
+	}
+
+	void goalsStayReachable()
+	{
+		// A goal that gets built over is still where units go, only the tiles around it lose their way
+		Field map;
+		FlowField field;
+		field.build(Field::width, Field::height, map.goals, map.open);
+		map.closed[2][2] = true;
+		field.invalidate(TilePosition(2, 2), 1, 1);
+		field.repair(map.open);
+		CHECK(field.getCost(TilePosition(2, 2)) == 0);
+		CHECK(field.getNext(TilePosition(2, 2)) == TilePosition(2, 2));
+		CHECK(matchesRebuild(map, field));
+	}
+}
+
+int main()
+{
+	repairMatchesRebuild();
+	goalsStayReachable();
+
+	if (failures == 0)
+		printf("All flow field checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// Standalone checks of the layered occupancy grids, they only need the headers in src
+// g++ -std=c++17 -Isrc tests/OccupancyTests.cpp -o OccupancyTests && ./OccupancyTests
+#include <cstdio>
+#include "Owner.h"
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	void neutralLayerIsRecorded()
+	{
+		Grid<Owner> owners;
+		Grid<LayerMask> layers;
+		owners.resize(8, 8);
+		layers.resize(8, 8);
+
+		addOwner(owners, layers, 3, 4, Owner{ OwnerType::Neutral, 42 });
+		CHECK((layers[3][4] & layerBit(OwnerType::Neutral)) != 0);
+		CHECK((layers[3][4] & solidLayers) != 0);
+		CHECK(owners[3][4] == (Owner{ OwnerType::Neutral, 42 }));
+		CHECK(layers[4][4] == 0);
+	}
+
+	void firstOwnerStaysAndLayersStack()
+	{
+		Grid<Owner> owners;
+		Grid<LayerMask> layers;
+		owners.resize(8, 8);
+		layers.resize(8, 8);
+
+		addOwner(owners, layers, 1, 1, Owner{ OwnerType::Mining, 0 });
+		addOwner(owners, layers, 1, 1, Owner{ OwnerType::Block, 5 });
+		addOwner(owners, layers, 1, 1, Owner{ OwnerType::Neutral, 7 });
+		CHECK(layers[1][1] == (layerBit(OwnerType::Mining) | layerBit(OwnerType::Block) | layerBit(OwnerType::Neutral)));
+		CHECK(owners[1][1] == (Owner{ OwnerType::Mining, 0 }));
+
+		addOwner(owners, layers, 2, 2, Owner());
+		CHECK(layers[2][2] == 0);
+		CHECK(owners[2][2].type == OwnerType::None);
+	}
+
+	void removingUndoesAdding()
+	{
+		Grid<Owner> owners;
+		Grid<LayerMask> layers;
+		owners.resize(8, 8);
+		layers.resize(8, 8);
+
+		// A neutral alone on a tile leaves nothing behind
+		addOwner(owners, layers, 2, 3, Owner{ OwnerType::Neutral, 9 });
+		CHECK(!removeOwner(owners, layers, 2, 3, OwnerType::Neutral));
+		CHECK(layers[2][3] == 0);
+		CHECK(owners[2][3].type == OwnerType::None);
+		CHECK(!removeOwner(owners, layers, 2, 3, OwnerType::Neutral));
+
+		// Under a Block the Block stays the owner and keeps the tile solid
+		addOwner(owners, layers, 4, 4, Owner{ OwnerType::Block, 1 });
+		addOwner(owners, layers, 4, 4, Owner{ OwnerType::Neutral, 9 });
+		CHECK(!removeOwner(owners, layers, 4, 4, OwnerType::Neutral));
+		CHECK(layers[4][4] == layerBit(OwnerType::Block));
+		CHECK(owners[4][4] == (Owner{ OwnerType::Block, 1 }));
+
+		// The neutral owned the tile, so the caller has to find the owner among what's left
+		addOwner(owners, layers, 5, 5, Owner{ OwnerType::Neutral, 9 });
+		addOwner(owners, layers, 5, 5, Owner{ OwnerType::Reserved, 0 });
+		CHECK(removeOwner(owners, layers, 5, 5, OwnerType::Neutral));
+		CHECK(layers[5][5] == layerBit(OwnerType::Reserved));
+		CHECK((layers[5][5] & solidLayers) == 0);
+	}
+
+	void miningAndReservedAreNotSolid()
+	{
+		CHECK((solidLayers & layerBit(OwnerType::Mining)) == 0);
+		CHECK((solidLayers & layerBit(OwnerType::Reserved)) == 0);
+		CHECK((solidLayers & layerBit(OwnerType::Block)) != 0);
+	}
+}
+
+int main()
+{
+	neutralLayerIsRecorded();
+	firstOwnerStaysAndLayersStack();
+	removingUndoesAdding();
+	miningAndReservedAreNotSolid();
+
+	if (failures == 0)
+		printf("All occupancy checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
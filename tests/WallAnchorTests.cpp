@@ -0,0 +1,227 @@
+// Standalone checks of the wall anchor pruning, they need the BWAPI headers and nothing else
+// g++ -std=c++17 -Isrc -I<BWAPI include> tests/WallAnchorTests.cpp -o WallAnchorTests && ./WallAnchorTests
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
+#include <queue>
+#include "WallAnchors.h"
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	// A ridge of rock with a 4 tile gap, the choke ends are the rock tiles on either side of the gap
+	//   ..........####..........
+	//   ..........####..........
+	//   ........................   rows 14 to 17
+	//   ..........####..........
+	struct Choke
+	{
+		static constexpr int width = 24, height = 32, radius = 10;
+		const TilePosition start = TilePosition(11, 15);
+		const vector<TilePosition> ends = { TilePosition(11, 13), TilePosition(11, 18) };
+		const vector<TilePosition> pieces = { TilePosition(3, 2), TilePosition(2, 2), TilePosition(2, 2) };
+
+		bool inside(const TilePosition t) const { return t.x >= 0 && t.y >= 0 && t.x < width && t.y < height; }
+		bool rock(const TilePosition t) const { return !inside(t) || (t.x >= 10 && t.x <= 13 && (t.y < 14 || t.y > 17)); }
+
+		bool fits(const TilePosition here, const TilePosition size) const
+		{
+			for (auto x = here.x; x < here.x + size.x; x++) {
+				for (auto y = here.y; y < here.y + size.y; y++) {
+					if (rock(TilePosition(x, y)))
+						return false;
+				}
+			}
+			return true;
+		}
+
+		// The root test of the search: the piece fits and has rock right next to one of its sides
+		bool rootTest(const TilePosition here, const TilePosition size) const
+		{
+			if (!fits(here, size))
+				return false;
+			for (auto x = here.x; x < here.x + size.x; x++) {
+				if (rock(TilePosition(x, here.y - 1)) || rock(TilePosition(x, here.y + size.y)))
+					return true;
+			}
+			for (auto y = here.y; y < here.y + size.y; y++) {
+				if (rock(TilePosition(here.x - 1, y)) || rock(TilePosition(here.x + size.x, y)))
+					return true;
+			}
+			return false;
+		}
+
+		// The square the search scanned before anchors, every tile that passes the root test
+		vector<TilePosition> oldRoots(const TilePosition size) const
+		{
+			vector<TilePosition> roots;
+			for (auto x = start.x - radius; x < start.x + radius; x++) {
+				for (auto y = start.y - radius; y < start.y + radius; y++) {
+					const TilePosition t(x, y);
+					if (t.isValid() && rootTest(t, size))
+						roots.push_back(t);
+				}
+			}
+			return roots;
+		}
+
+		vector<TilePosition> anchors(const TilePosition size) const
+		{
+			auto reach = 1;
+			for (auto& piece : pieces)
+				reach = max(reach, max(piece.x, piece.y));
+			return findAnchors(start, radius, size, ends, reach, [&](const TilePosition t) { return rootTest(t, size); });
+		}
+	};
+
+	using Placement = vector<pair<TilePosition, TilePosition>>;
+
+	bool overlaps(const Placement& wall, const TilePosition here, const TilePosition size)
+	{
+		for (auto& piece : wall) {
+			if (here.x < piece.first.x + piece.second.x && piece.first.x < here.x + size.x && here.y < piece.first.y + piece.second.y && piece.first.y < here.y + size.y)
+				return true;
+		}
+		return false;
+	}
+
+	// True when the wall cuts the left edge of the map off from the right edge
+	bool closes(const Choke& choke, const Placement& wall)
+	{
+		vector<vector<bool>> seen(Choke::width, vector<bool>(Choke::height, false));
+		queue<TilePosition> open;
+		open.push(TilePosition(0, 15));
+		seen[0][15] = true;
+		while (!open.empty()) {
+			const auto t = open.front();
+			open.pop();
+			if (t.x == Choke::width - 1)
+				return false;
+			for (auto& d : { TilePosition(1, 0), TilePosition(-1, 0), TilePosition(0, 1), TilePosition(0, -1) }) {
+				const auto next = t + d;
+				if (choke.rock(next) || seen[next.x][next.y] || overlaps(wall, next, TilePosition(1, 1)))
+					continue;
+				seen[next.x][next.y] = true;
+				open.push(next);
+			}
+		}
+		return true;
+	}
+
+	// Same shape as the wall search: every ordering of the pieces, the first from the roots and every next one sharing an edge with the one before
+	struct Search
+	{
+		const Choke& choke;
+		Placement current, best;
+		int bestScore = INT_MAX;
+
+		int score(const Placement& wall) const
+		{
+			auto total = 0;
+			for (auto& piece : wall)
+				total += abs(piece.first.x - choke.start.x) + abs(piece.first.y - choke.start.y);
+			return total;
+		}
+
+		void place(const vector<TilePosition>& order, const size_t i)
+		{
+			if (i == order.size()) {
+				if (!closes(choke, current))
+					return;
+				auto sorted = current;
+				sort(sorted.begin(), sorted.end());
+				const auto value = score(sorted);
+				if (value < bestScore || (value == bestScore && sorted < best))
+					best = sorted, bestScore = value;
+				return;
+			}
+
+			const auto size = order[i];
+			const auto parent = current.back();
+			vector<TilePosition> candidates;
+			for (auto y = parent.first.y - size.y + 1; y < parent.first.y + parent.second.y; y++) {
+				candidates.emplace_back(parent.first.x - size.x, y);
+				candidates.emplace_back(parent.first.x + parent.second.x, y);
+			}
+			for (auto x = parent.first.x - size.x + 1; x < parent.first.x + parent.second.x; x++) {
+				candidates.emplace_back(x, parent.first.y - size.y);
+				candidates.emplace_back(x, parent.first.y + parent.second.y);
+			}
+			for (auto& t : candidates) {
+				if (!choke.fits(t, size) || overlaps(current, t, size))
+					continue;
+				current.emplace_back(t, size);
+				place(order, i + 1);
+				current.pop_back();
+			}
+		}
+
+		template <class Roots>
+		Placement run(Roots roots)
+		{
+			auto order = choke.pieces;
+			sort(order.begin(), order.end());
+			do {
+				for (auto& t : roots(order.front())) {
+					current = { make_pair(t, order.front()) };
+					place(order, 1);
+				}
+			} while (next_permutation(order.begin(), order.end()));
+			return best;
+		}
+	};
+
+	void anchorsAreOldRoots()
+	{
+		Choke choke;
+		for (auto& size : choke.pieces) {
+			const auto roots = choke.oldRoots(size);
+			const auto anchors = choke.anchors(size);
+			for (auto& t : anchors)
+				CHECK(find(roots.begin(), roots.end(), t) != roots.end());
+
+			// Same scan order, so the anchors are the roots with the rest left out
+			vector<TilePosition> kept;
+			for (auto& t : roots) {
+				if (find(anchors.begin(), anchors.end(), t) != anchors.end())
+					kept.push_back(t);
+			}
+			CHECK(kept == anchors);
+			CHECK(anchors.size() < roots.size());
+		}
+	}
+
+	void anchorsFindTheSameWall()
+	{
+		Choke choke;
+		Search fromRoots{ choke }, fromAnchors{ choke };
+		const auto oldBest = fromRoots.run([&](const TilePosition size) { return choke.oldRoots(size); });
+		const auto newBest = fromAnchors.run([&](const TilePosition size) { return choke.anchors(size); });
+		CHECK(!oldBest.empty());
+		CHECK(oldBest == newBest);
+		CHECK(fromRoots.bestScore == fromAnchors.bestScore);
+	}
+
+	void gapCountsTilesBetween()
+	{
+		CHECK(tileGap(TilePosition(2, 2), TilePosition(2, 2), TilePosition(3, 3)) == 0);
+		CHECK(tileGap(TilePosition(2, 2), TilePosition(2, 2), TilePosition(4, 2)) == 1);
+		CHECK(tileGap(TilePosition(2, 2), TilePosition(2, 2), TilePosition(0, 5)) == 2);
+	}
+}
+
+int main()
+{
+	gapCountsTilesBetween();
+	anchorsAreOldRoots();
+	anchorsFindTheSameWall();
+
+	if (failures == 0)
+		printf("All wall anchor checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+// Standalone checks that the bitboard path of the wall search is the path findPath finds, they need the BWAPI headers and src/BitBoard.cpp
+// g++ -std=c++17 -Isrc -I<BWAPI include> tests/WallPathTests.cpp src/BitBoard.cpp -o WallPathTests && ./WallPathTests
+#include <cstdio>
+#include <queue>
+#include <random>
+#include "BitBoard.h"
+
+using namespace BWEB;
+
+namespace
+{
+	int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); failures++; } } while (false)
+
+	struct Board
+	{
+		int width = 0, height = 0;
+		vector<vector<bool>> open;
+		BitBoard passable;
+
+		Board(const int w, const int h) : width(w), height(h), open(w, vector<bool>(h, false)) {}
+
+		void setOpen(const int x, const int y, const bool isOpen)
+		{
+			open[x][y] = isOpen;
+			if (isOpen)
+				passable.set(x, y);
+			else
+				passable.reset(x, y);
+		}
+	};
+
+	// The queue search findPath runs without diagonals, a tile is never checked for collision as the source and keeps the first tile that reached it as its parent
+	vector<TilePosition> queuePath(const Board& board, const TilePosition source, const TilePosition target)
+	{
+		const TilePosition directions[4] = { { 0, 1 }, { 1, 0 }, { -1, 0 }, { 0, -1 } };
+		const uint8_t root = 0xFF;
+		vector<vector<uint8_t>> parents(board.width, vector<uint8_t>(board.height, 0));
+
+		struct Node { TilePosition tile, parent; uint8_t code; };
+		queue<Node> nodes;
+		nodes.push({ source, source, root });
+		while (!nodes.empty()) {
+			const auto current = nodes.front();
+			nodes.pop();
+			if (current.tile == target) {
+				vector<TilePosition> path = { target };
+				auto check = current.parent;
+				do {
+					path.push_back(check);
+					const auto code = parents[check.x][check.y];
+					check = code == root ? source : check - directions[code - 1];
+				} while (check != source);
+				return path;
+			}
+
+			const auto tile = current.tile;
+			if (parents[tile.x][tile.y] != 0)
+				continue;
+			parents[tile.x][tile.y] = current.code;
+			for (int i = 0; i < 4; i++) {
+				const auto next = tile + directions[i];
+				if (next.x < 0 || next.y < 0 || next.x >= board.width || next.y >= board.height || parents[next.x][next.y] != 0 || !board.open[next.x][next.y])
+					continue;
+				nodes.push({ next, tile, uint8_t(i + 1) });
+			}
+		}
+		return {};
+	}
+
+	void samePathAsQueueSearch()
+	{
+		// Random boards of every density, with the source sometimes closed like a start tile under overlap can be
+		mt19937 random(11);
+		BitSearch forward, back;
+		auto compared = 0, found = 0, mismatches = 0;
+		for (auto trial = 0; trial < 600; trial++) {
+			Board board(1 + int(random() % 96), 1 + int(random() % 96));
+			const auto density = 40 + int(random() % 55);
+			for (auto x = 0; x < board.width; x++) {
+				for (auto y = 0; y < board.height; y++)
+					board.setOpen(x, y, int(random() % 100) < density);
+			}
+
+			const TilePosition source(int(random() % board.width), int(random() % board.height));
+			const TilePosition target(int(random() % board.width), int(random() % board.height));
+			if (source == target)
+				continue;
+			board.setOpen(target.x, target.y, true);
+			if (random() % 4 == 0)
+				board.setOpen(source.x, source.y, false);
+
+			const auto expected = queuePath(board, source, target);
+			const auto path = shortestPath(board.passable, board.height, source, target, forward, back);
+			mismatches += path != expected;
+			found += !expected.empty();
+			compared++;
+		}
+		CHECK(compared > 500);
+		CHECK(found > 100);
+		CHECK(mismatches == 0);
+	}
+
+	void adjacentTargetKeepsSource()
+	{
+		Board board(4, 4);
+		for (auto x = 0; x < 4; x++) {
+			for (auto y = 0; y < 4; y++)
+				board.setOpen(x, y, true);
+		}
+		BitSearch forward, back;
+		const auto path = shortestPath(board.passable, board.height, TilePosition(1, 1), TilePosition(2, 1), forward, back);
+		CHECK(path == (vector<TilePosition>{ TilePosition(2, 1), TilePosition(1, 1) }));
+	}
+
+	void tiesGoDownFirst()
+	{
+		// Both ways around the corner are as short, the queue search steps down before right
+		Board board(3, 3);
+		for (auto x = 0; x < 3; x++) {
+			for (auto y = 0; y < 3; y++)
+				board.setOpen(x, y, true);
+		}
+		BitSearch forward, back;
+		const auto path = shortestPath(board.passable, board.height, TilePosition(0, 0), TilePosition(1, 1), forward, back);
+		CHECK(path == (vector<TilePosition>{ TilePosition(1, 1), TilePosition(0, 1) }));
+		CHECK(path == queuePath(board, TilePosition(0, 0), TilePosition(1, 1)));
+	}
+}
+
+int main()
+{
+	adjacentTargetKeepsSource();
+	tiesGoDownFirst();
+	samePathAsQueueSearch();
+
+	if (failures == 0)
+		printf("All wall path checks passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "PrecomputeModule.h"
+#include "BWEB.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace BWEB
+{
+	namespace {
+
+		const string outputFolder = "bwapi-data/write/BWEB/";
+
+		struct Job
+		{
+			TilePosition start;
+			BWAPI::Race race;
+		};
+
+		struct Result
+		{
+			double startMs = 0.0, blocksMs = 0.0, wallsMs = 0.0;
+			size_t stations = 0, blocks = 0, small = 0, medium = 0, large = 0;
+			size_t walls = 0, wallPieces = 0, wallDefenses = 0;
+			bool saved = false;
+		};
+
+		double millisecondsSince(const chrono::steady_clock::time_point start)
+		{
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		}
+
+		// The walls most bots of each race ask for
+		void createStandardWalls(Map& map, const BWAPI::Race race)
+		{
+			if (race == Races::Protoss) {
+				vector<UnitType> buildings = { UnitTypes::Protoss_Pylon, UnitTypes::Protoss_Gateway, UnitTypes::Protoss_Forge };
+				map.createWall(buildings, map.getNaturalArea(), map.getNaturalChoke(), UnitTypes::None, { UnitTypes::Protoss_Photon_Cannon, UnitTypes::Protoss_Photon_Cannon }, true);
+			}
+			else if (race == Races::Terran) {
+				vector<UnitType> buildings = { UnitTypes::Terran_Barracks, UnitTypes::Terran_Supply_Depot, UnitTypes::Terran_Supply_Depot };
+				map.createWall(buildings, map.getMainArea(), map.getMainChoke(), UnitTypes::Protoss_Zealot, { UnitTypes::Terran_Bunker }, false, true);
+			}
+			else if (race == Races::Zerg) {
+				vector<UnitType> buildings = { UnitTypes::Zerg_Hatchery, UnitTypes::Zerg_Evolution_Chamber };
+				map.createWall(buildings, map.getNaturalArea(), map.getNaturalChoke(), UnitTypes::None, { UnitTypes::Zerg_Sunken_Colony, UnitTypes::Zerg_Sunken_Colony }, true);
+			}
+		}
+
+		// Runs the full pipeline on its own Map, nothing is shared with the other jobs except read only BWAPI and BWEM state
+		Result run(const Job& job, const string& mapHash)
+		{
+			Result result;
+			auto map = make_unique<Map>(BWEM::Map::Instance(), BroodwarPtr);
+			map->setPerspective(job.start, job.race);
+
+			auto start = chrono::steady_clock::now();
+			map->onStart();
+			result.startMs = millisecondsSince(start);
+
+			start = chrono::steady_clock::now();
+			createStandardWalls(*map, job.race);
+			result.wallsMs = millisecondsSince(start);
+
+			start = chrono::steady_clock::now();
+			map->findBlocks(job.race);
+			result.blocksMs = millisecondsSince(start);
+
+			result.stations = map->Stations().size();
+			result.blocks = map->Blocks().size();
+			for (auto& block : map->Blocks()) {
+				result.small += block.SmallTiles().size();
+				result.medium += block.MediumTiles().size();
+				result.large += block.LargeTiles().size();
+			}
+			result.walls = map->getWalls().size();
+			for (auto& wall : map->getWalls()) {
+				result.wallDefenses += wall.getDefenses().size();
+				result.wallPieces += wall.getSlots().size() - wall.getDefenses().size();
+			}
+
+			result.saved = map->saveLayout(outputFolder + layoutFile(mapHash, job.start, job.race));
+			return result;
+		}
+	}
+
+	string layoutFile(const string& mapHash, const TilePosition start, const BWAPI::Race race)
+	{
+		return mapHash + "_" + to_string(start.x) + "_" + to_string(start.y) + "_" + to_string(race.getID()) + ".bweb";
+	}
+
+	void PrecomputeModule::onStart()
+	{
+		BWEM::Map::Instance().Initialize();
+		BWEM::Map::Instance().EnableAutomaticPathAnalysis();
+		BWEM::Map::Instance().FindBasesForStartingLocations();
+
+		vector<Job> jobs;
+		for (auto& start : Broodwar->getStartLocations()) {
+			for (auto& race : { Races::Protoss, Races::Terran, Races::Zerg })
+				jobs.push_back({ start, race });
+		}
+
+		// Every core pulls the next job until none are left, the same as findLayouts the game thread waits here so nothing changes the game while the jobs read it
+		const auto mapHash = Broodwar->mapHash();
+		vector<Result> results(jobs.size());
+		atomic<size_t> next{ 0 };
+		const auto worker = [&]() {
+			for (auto i = next++; i < jobs.size(); i = next++)
+				results[i] = run(jobs[i], mapHash);
+		};
+		vector<thread> threads;
+		for (auto i = max(1u, thread::hardware_concurrency()); i > 0; i--)
+			threads.emplace_back(worker);
+		for (auto& t : threads)
+			t.join();
+
+		// One row per start location and race, appended so a whole map pool ends up in one report
+		const auto reportFile = outputFolder + "report.csv";
+		const auto header = !ifstream(reportFile).good();
+		ofstream report(reportFile, ios::app);
+		if (header)
+			report << "map,hash,startX,startY,race,onStartMs,wallsMs,findBlocksMs,stations,blocks,small,medium,large,walls,wallPieces,wallDefenses,saved\n";
+		for (size_t i = 0; i < jobs.size(); i++) {
+			auto& job = jobs[i];
+			auto& result = results[i];
+			report << Broodwar->mapName() << "," << mapHash << "," << job.start.x << "," << job.start.y << "," << job.race.getName() << ","
+				<< result.startMs << "," << result.wallsMs << "," << result.blocksMs << ","
+				<< result.stations << "," << result.blocks << "," << result.small << "," << result.medium << "," << result.large << ","
+				<< result.walls << "," << result.wallPieces << "," << result.wallDefenses << "," << result.saved << "\n";
+		}
+
+		Broodwar->leaveGame();
+	}
+}
+
+#ifdef _WIN32
+extern "C" __declspec(dllexport) void gameInit(BWAPI::Game* game) { BWAPI::BroodwarPtr = game; }
+extern "C" __declspec(dllexport) BWAPI::AIModule* newAIModule() { return new BWEB::PrecomputeModule(); }
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include <BWAPI.h>
+#include <string>
+
+namespace BWEB
+{
+	// AI module that lays out BWEB for every start location and race of the map it is started on, writes a layout file for each and leaves the game
+	class PrecomputeModule : public BWAPI::AIModule
+	{
+	public:
+		void onStart() override;
+	};
+
+	// Returns the file a layout is written to, bots load the same name from their read folder
+	std::string layoutFile(const std::string& mapHash, BWAPI::TilePosition start, BWAPI::Race race);
+}